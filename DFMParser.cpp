@@ -10,6 +10,10 @@
 
 #include "DFMParser.h"
 #include "helpers.h"
+#include "formcache.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
 
 #include <exception>
 
@@ -33,6 +37,37 @@ bool isTopElement(const DFMData& dfmres, const std::string& name)
 	return false;
 }
 
+/**
+* Visits all resources of a DFM tree.
+* @param dfmData The DFM tree.
+**/
+void DFMVisitor::visit(DFMData& dfmData)
+{
+	for (unsigned int i=0;i<dfmData.size();++i)
+	{
+		visit(dfmData[i]);
+	}
+}
+
+/**
+* Visits a resource, its properties and all of its children.
+* @param res The resource.
+**/
+void DFMVisitor::visit(DFMResource* res)
+{
+	resourceCallback(res);
+	
+	for (unsigned int i=0;i<res->properties.size();++i)
+	{
+		propertyCallback(res->properties[i]);
+	}
+	
+	for (unsigned int i=0;i<res->children.size();++i)
+	{
+		visit(res->children[i]);
+	}
+}
+
 /**
 * Skips over the data of a property because in most cases the data is not
 * important for obfuscation.
@@ -54,6 +89,7 @@ unsigned int skipData(unsigned char*& dataptr, DFMData& dfmres, DFMResource* res
 			{
 				DFMProperty p;
 				p.offset = offset + skip - 1;
+				addCounter(COUNTER_DFM_PROPERTIES);
 				skip += skipData(dataptr, dfmres, res, p, offset + skip);
 				property.values.push_back(p);
 			}
@@ -91,7 +127,7 @@ unsigned int skipData(unsigned char*& dataptr, DFMData& dfmres, DFMResource* res
 				unsigned int size = *(unsigned int*)dataptr;
 				dataptr += 4;
 				std::string type = readPascalString<unsigned char>((const unsigned char*)dataptr);
-				if (verifyPascalString<ValidCharacter>(type))
+				if (isIdentifier(type))
 				{
 					property.value.push_back(new std::string(type));
 				}
@@ -126,6 +162,7 @@ unsigned int skipData(unsigned char*& dataptr, DFMData& dfmres, DFMResource* res
 				{
 					DFMProperty prop;
 					prop.offset = offset + skip;
+					addCounter(COUNTER_DFM_PROPERTIES);
 					std::string propertyname = readPascalString<unsigned char>(dataptr);
 					prop.name.push_back(new std::string(propertyname));
 
@@ -171,7 +208,7 @@ unsigned int skipData(unsigned char*& dataptr, DFMData& dfmres, DFMResource* res
 **/
 unsigned int parseDFMResource(unsigned char*& dataptr, unsigned int offset, unsigned int maxoffset, DFMData& dfmresources, DFMResource* parent)
 {
-	if (offset > maxoffset) throw new std::string("Error: Failure when reading DFM data.");
+	if (offset > maxoffset) throw std::string("Error: Failure when reading DFM data.");
 	
 	// Skip leading Fx bytes.
 	if (*dataptr == 0xF1 || *dataptr == 0xF4)
@@ -187,6 +224,7 @@ unsigned int parseDFMResource(unsigned char*& dataptr, unsigned int offset, unsi
 
 	// Read the current resource.
 	DFMResource* dfmres = new DFMResource();
+	addCounter(COUNTER_DFM_RESOURCES);
 
 	dfmres->offset = offset;
 	dfmres->classname = new std::string(readPascalString<unsigned char>(dataptr));
@@ -207,6 +245,7 @@ unsigned int parseDFMResource(unsigned char*& dataptr, unsigned int offset, unsi
 		DFMProperty property;
 			
 		property.offset = offset;
+		addCounter(COUNTER_DFM_PROPERTIES);
 		std::string* name = new std::string(readPascalString<unsigned char>(dataptr));
 		property.name.push_back(name);
 
@@ -236,9 +275,12 @@ unsigned int parseDFMResource(unsigned char*& dataptr, unsigned int offset, unsi
 * Reads all DFM resources from a file.
 * @param pefile PEFile to be read.
 * @param dfmresources All recognized DFM resources will be stored here.
+* @param cacheDirectory Directory of the form cache (empty if no cache is used).
 **/
-void readDFMResources(PeLib::PeFile32& pefile, DFMData& dfmresources)
+void readDFMResources(PeLib::PeFile32& pefile, DFMData& dfmresources, const std::string& cacheDirectory)
 {
+	PhaseTimer timer(PHASE_DFM);
+	
 	PeLib::ResourceDirectory& resdir = pefile.resDir();
 	
 	unsigned int numberOfResources = resdir.getNumberOfResources(PeLib::PELIB_RT_RCDATA);
@@ -260,8 +302,34 @@ void readDFMResources(PeLib::PeFile32& pefile, DFMData& dfmresources)
 			PeLib::ResourceLeaf* currLeaf = static_cast<PeLib::ResourceLeaf*>(currNode->getChild(0));
 
 			unsigned char* data = &resourceData[4]; // Skip the "TPF0" identifier.
+			unsigned int size = static_cast<unsigned int>(resourceData.size() - 4);
 			unsigned int offset = pefile.peHeader().rvaToOffset(currLeaf->getOffsetToData() + 4);
-			parseDFMResource(data, offset, offset + resourceData.size() - 4, dfmresources, 0);
+			
+			TraceSpan span("form", g_tracing ? "0x" + toHexString(offset) : "");
+			
+			PYTHIA_PROBE2(dfm__resource__start, offset, size);
+			
+			if (!cacheDirectory.empty())
+			{
+				if (DFMResource* dfm = loadCachedForm(cacheDirectory, data, size, offset))
+				{
+					addCounter(COUNTER_FORM_CACHE_HITS);
+					dfmresources.push_back(dfm);
+					PYTHIA_PROBE2(dfm__resource__done, offset, dfm->name->c_str());
+					continue;
+				}
+				
+				addCounter(COUNTER_FORM_CACHE_MISSES);
+			}
+			
+			parseDFMResource(data, offset, offset + size, dfmresources, 0);
+			
+			PYTHIA_PROBE2(dfm__resource__done, offset, dfmresources.back()->name->c_str());
+			
+			if (!cacheDirectory.empty())
+			{
+				saveCachedForm(cacheDirectory, &resourceData[4], size, offset, dfmresources.back());
+			}
 		}
 	}
 }
@@ -13,6 +13,8 @@
 
 #include <PeLib.h>
 
+#include <string>
+
 enum {	DFM_VARIANT = 0,
 		DFM_ARRAY = 1,
 		DFM_BYTE = 2,
@@ -44,6 +46,11 @@ struct DFMProperty
 	std::vector<std::string*> name;
 	std::vector<std::string*> value;
 	std::vector<DFMProperty> values;
+	
+	/// False if the value must keep its original text (see checkStringCollisions).
+	bool obfuscateValue;
+	
+	DFMProperty() : type(0), offset(0), obfuscateValue(true) {}
 };
 
 /**
@@ -66,7 +73,32 @@ struct DFMResource
 
 typedef std::vector<DFMResource*> DFMData;
 
-void readDFMResources(PeLib::PeFile32& pefile, DFMData& dfmresources);
+/**
+* Base class of objects that look at every form, component and property of
+* a DFM tree. Each resource is visited before its properties and the
+* properties before the child resources.
+**/
+class DFMVisitor
+{
+	protected:
+		/**
+		* Called for each DFMResource in the DFM directory.
+		**/
+		virtual void resourceCallback(DFMResource* res) = 0;
+		
+		/**
+		* Called for each DFMProperty of the last visited resource.
+		**/
+		virtual void propertyCallback(DFMProperty& property) = 0;
+		
+	public:
+		virtual ~DFMVisitor() {}
+		
+		void visit(DFMData& dfmData);
+		void visit(DFMResource* res);
+};
+
+void readDFMResources(PeLib::PeFile32& pefile, DFMData& dfmresources, const std::string& cacheDirectory = "");
 bool isTopElement(const DFMData& dfmres, const std::string& name);
 
 #endif
@@ -9,10 +9,16 @@
 */
 
 #include "VMTDir.h"
+#include "collections.h"
+#include "symcache.h"
+#include "stats.h"
+#include "probes.h"
+#include "threads.h"
+#include "memstats.h"
+#include "trace.h"
 
 #include <algorithm>
-
-extern unsigned int g_recognizedVmts;
+#include <map>
 
 /**
 * Adds a child VMT to a given parent VMT.
@@ -209,7 +215,7 @@ VMT* readVMT(const unsigned char* file, unsigned int offset, PeLib::PeHeader32&
 	const unsigned char* no = file + vmt->nameoffset;
 	std::string name = readPascalString<unsigned char>(no);
 	
-	if (!verifyPascalString<ValidCharacter>(name))
+	if (!isIdentifier(name))
 	{
 		delete vmt;
 		return 0;
@@ -266,16 +272,128 @@ void fix(VMTDir& root)
 	}
 }
 
+/**
+* The type of a property as it was resolved from a type info record.
+**/
+struct ResolvedType
+{
+	unsigned int offset;
+	std::string* type;
+	
+	/**
+	* True if the type string was allocated for this record only (it's
+	* neither the name of a VMT nor taken from a SymbolCache).
+	**/
+	bool owned;
+};
+
+/**
+* Maps the addresses of type info records to their resolved types.
+**/
+typedef std::map<unsigned int, ResolvedType> TypeCache;
+
+/**
+* Resolved types that are shared by all threads of readExtraInfo. Each type
+* info record is resolved to exactly one type string no matter which thread
+* reads it first.
+**/
+struct SharedTypes
+{
+	Mutex mutex;
+	TypeCache types;
+};
+
 class ReadExtraInfo
 {
 	private:
 		const VMTDir& vmtdir_;
-		unsigned char* file_;
+		const unsigned char* file_;
 		const PeLib::PeHeader32& peh_;
+		SymbolCache* cache_;
+		SharedTypes& shared_;
+		TypeCache types_;
+		
+		/**
+		* Reads the type info record of a property type.
+		* @param proptype Address of the type info record.
+		* @return The file offset of the type name and the type (0 if the
+		*         record is invalid).
+		**/
+		ResolvedType resolveType(unsigned int proptype)
+		{
+			ResolvedType resolved;
+			resolved.offset = peh_.rvaToOffset(proptype - peh_.getImageBase());
+			resolved.type = 0;
+			resolved.owned = false;
+			
+			if (resolved.offset == std::numeric_limits<unsigned int>::max())
+			{
+				return resolved;
+			}
+			
+			resolved.offset += 5;
+			std::string type = readPascalString<unsigned char>(file_ + resolved.offset);
+			
+			if (!isIdentifier(type))
+			{
+				return resolved;
+			}
+			
+			VMT* typevmt = find<FindByName>(vmtdir_, type);
+			if (typevmt)
+			{
+				resolved.type = typevmt->name;
+			}
+			else if (cache_)
+			{
+				resolved.type = cache_->typeName(type);
+			}
+			else
+			{
+				resolved.type = new std::string(type);
+				resolved.owned = true;
+			}
+			
+			return resolved;
+		}
+		
+		/**
+		* Returns the resolved type of a type info record. Records that were
+		* already resolved by another thread are taken from the shared types.
+		* @param proptype Address of the type info record.
+		* @return The resolved type.
+		**/
+		const ResolvedType& lookupType(unsigned int proptype)
+		{
+			{
+				ScopedLock lock(shared_.mutex);
+				TypeCache::const_iterator Iter = shared_.types.find(proptype);
+				
+				if (Iter != shared_.types.end())
+				{
+					return types_.insert(*Iter).first->second;
+				}
+			}
+			
+			// Resolving searches the whole VMT directory, so it's done
+			// without holding the lock.
+			ResolvedType resolved = resolveType(proptype);
+			
+			ScopedLock lock(shared_.mutex);
+			std::pair<TypeCache::iterator, bool> inserted = shared_.types.insert(std::make_pair(proptype, resolved));
+			
+			if (!inserted.second && resolved.owned)
+			{
+				// Another thread was faster.
+				delete resolved.type;
+			}
+			
+			return types_.insert(*inserted.first).first->second;
+		}
 		
 	public:
-		ReadExtraInfo(const VMTDir& vmtdir, unsigned char* file, PeLib::PeHeader32& peh)
-			: vmtdir_(vmtdir), file_(file), peh_(peh) {}
+		ReadExtraInfo(const VMTDir& vmtdir, const unsigned char* file, const PeLib::PeHeader32& peh, SymbolCache* cache, SharedTypes& shared)
+			: vmtdir_(vmtdir), file_(file), peh_(peh), cache_(cache), shared_(shared) {}
 		
 		void operator()(VMT* vmt)
 		{
@@ -286,6 +404,7 @@ class ReadExtraInfo
 				if (tioffset != std::numeric_limits<unsigned int>::max())
 				{
 					readFieldTable(vmt, file_ + tioffset, tioffset);
+					addCounter(COUNTER_FIELDS, vmt->fields.size());
 				}
 			}
 		
@@ -296,6 +415,7 @@ class ReadExtraInfo
 				if (tioffset != std::numeric_limits<unsigned int>::max())
 				{
 					readMethodInfo(vmt, file_ + tioffset, tioffset);
+					addCounter(COUNTER_METHODS, vmt->methods.size());
 				}
 			}
 			
@@ -305,30 +425,28 @@ class ReadExtraInfo
 				if (tioffset != std::numeric_limits<unsigned int>::max())
 				{
 					readTypeInfo(vmt, file_ + tioffset, tioffset);
+					addCounter(COUNTER_PROPERTIES, vmt->typeinfo.size());
 					
 					for (unsigned int i=0;i<vmt->typeinfo.size();++i)
 					{
-					    vmt->typeinfo[i].typeoffset = peh_.rvaToOffset(vmt->typeinfo[i].PropType - peh_.getImageBase());
-		
-					    if (vmt->typeinfo[i].typeoffset != std::numeric_limits<unsigned int>::max())
-					    {
-							vmt->typeinfo[i].typeoffset += 5;
-							const unsigned char* typeinfoaddr = file_ + vmt->typeinfo[i].typeoffset;
-							std::string type = readPascalString<unsigned char>(typeinfoaddr);
-							if (!verifyPascalString<ValidCharacter>(type))
-							{
-								continue;
-							}
-		
-							VMT* typevmt = find<FindByName>(vmtdir_, type);
-							if (typevmt)
-							{
-								vmt->typeinfo[i].type = typevmt->name;
-							}
-							else
-							{
-								vmt->typeinfo[i].type = new std::string(type);
-							}
+						PropInfo& pi = vmt->typeinfo[i];
+						
+						// Few types are used by many properties. Each type info
+						// record is only read once per thread.
+						TypeCache::const_iterator Iter = types_.find(pi.PropType);
+						
+						if (Iter != types_.end())
+						{
+							addCounter(COUNTER_TYPE_CACHE_HITS);
+							pi.typeoffset = Iter->second.offset;
+							pi.type = Iter->second.type;
+						}
+						else
+						{
+							addCounter(COUNTER_TYPE_CACHE_MISSES);
+							const ResolvedType& resolved = lookupType(pi.PropType);
+							pi.typeoffset = resolved.offset;
+							pi.type = resolved.type;
 						}
 					}
 				}
@@ -336,18 +454,224 @@ class ReadExtraInfo
 		}
 };
 
+/**
+* Everything that's needed to read the fields, methods and properties of
+* VMTs on first access (see readVMTs). The object deletes itself once
+* the last of its VMTs was read.
+**/
+class ExtraInfoSource
+{
+	private:
+		std::vector<unsigned char> file_;
+		PeLib::PeHeader32 peh_;
+		SharedTypes types_;
+		ReadExtraInfo* reader_;
+		
+		/**
+		* Number of VMTs that were not yet read.
+		**/
+		unsigned int pending_;
+		
+		ExtraInfoSource(const ExtraInfoSource&);
+		ExtraInfoSource& operator=(const ExtraInfoSource&);
+		
+		~ExtraInfoSource()
+		{
+			delete reader_;
+		}
+		
+	public:
+		/**
+		* Creates a new ExtraInfoSource object.
+		* @param file The data of the file. The data is taken over by the object.
+		* @param peh PE header of the file.
+		* @param vmtdir The VMTs. fix must have been called before.
+		* @param cache Optional cache for names that are shared between files.
+		* @param pending Number of VMTs that refer to the object.
+		**/
+		ExtraInfoSource(std::vector<unsigned char>& file, const PeLib::PeHeader32& peh, const VMTDir& vmtdir, SymbolCache* cache, unsigned int pending)
+			: peh_(peh), pending_(pending)
+		{
+			file_.swap(file);
+			reader_ = new ReadExtraInfo(vmtdir, &file_[0], peh_, cache, types_);
+		}
+		
+		/**
+		* Reads the fields, methods and properties of a VMT.
+		* @param vmt A VMT that refers to the object.
+		**/
+		void read(VMT* vmt)
+		{
+			(*reader_)(vmt);
+			release();
+		}
+		
+		/**
+		* Called for each VMT that doesn't refer to the object anymore.
+		**/
+		void release()
+		{
+			if (--pending_ == 0) delete this;
+		}
+};
+
+/**
+* Searches through the data of a file and tries to find valid VMTs. The VMTs
+* are not yet arranged in their hierarchy (see fix) and their extra
+* information is not yet read (see readExtraInfo).
+* @param file The data of the file.
+* @param size Size of the file data.
+* @param peh PE header of the file.
+* @param vmtdir All found VMTs will be stored here.
+* @param candidates Receives the number of locations that looked like VMTs.
+* @return The number of recognized VMTs.
+**/
+unsigned int scanVMTs(const unsigned char* file, unsigned int size, PeLib::PeHeader32& peh, VMTDir& vmtdir, unsigned int& candidates)
+{
+	unsigned int recognized = 0;
+	candidates = 0;
+	
+	for (unsigned int i=0;i + 4 <= size;i+=4) // All VMTs are DWORD-aligned
+	{
+		PeLib::dword d = *(const PeLib::dword*)(file + i);
+		PeLib::dword o = peh.rvaToOffset(d - peh.getImageBase());
+
+		if (o == std::numeric_limits<PeLib::dword>::max()) continue;
+
+		if (d >= peh.getImageBase() && o >= 0x200 && i >= 0x200)
+		{
+			if (o == i + 76)
+			{
+				++candidates;
+				
+				if (VMT* vmt = readVMT(file, i, peh))
+				{
+					vmt->offset = i;
+					insert(vmtdir, vmt);
+					++recognized;
+					
+					PYTHIA_PROBE2(vmt__accept, i, vmt->name->c_str());
+				}
+			}
+		}
+	}
+	
+	addCounter(COUNTER_CANDIDATES, candidates);
+	addCounter(COUNTER_VMTS, recognized);
+	
+	return recognized;
+}
+
+/**
+* Number of VMTs a thread of readExtraInfo takes at once.
+**/
+const unsigned int EXTRAINFO_CHUNK = 16;
+
+/**
+* Minimum number of VMTs per thread. Smaller files aren't worth the
+* thread start-up.
+**/
+const unsigned int EXTRAINFO_MIN_VMTS = 256;
+
+/**
+* Shared state of the threads of readExtraInfo.
+**/
+struct ExtraInfoState
+{
+	std::vector<VMT*> vmts;
+	const VMTDir* vmtdir;
+	const unsigned char* file;
+	const PeLib::PeHeader32* peh;
+	SymbolCache* cache;
+	SharedTypes types;
+	
+	/// The statistics of the thread that started the workers.
+	Statistics* statistics;
+	
+	/**
+	* Index of the next VMT that's not yet taken by a thread.
+	**/
+	volatile unsigned int next;
+};
+
+void extraInfoWorker(void* argument)
+{
+	ExtraInfoState& state = *static_cast<ExtraInfoState*>(argument);
+	
+	StatisticsScope scope(*state.statistics);
+	
+	unsigned int previousPhase = setAllocationPhase(PHASE_EXTRAINFO);
+	
+	{
+		TraceSpan span("extrainfo worker");
+		
+		ReadExtraInfo reader(*state.vmtdir, state.file, *state.peh, state.cache, state.types);
+		
+		for (;;)
+		{
+			unsigned int first = atomicAdd(state.next, EXTRAINFO_CHUNK);
+			
+			if (first >= state.vmts.size()) break;
+			
+			unsigned int last = std::min(first + EXTRAINFO_CHUNK, static_cast<unsigned int>(state.vmts.size()));
+			
+			for (unsigned int i=first;i<last;++i)
+			{
+				reader(state.vmts[i]);
+			}
+		}
+	}
+	
+	setAllocationPhase(previousPhase);
+}
+
+/**
+* Reads the fields, methods and properties of all VMTs. The tables of each
+* VMT are independent of each other, so the VMTs are distributed over
+* several threads. The result doesn't depend on the number of threads.
+* @param vmtdir The VMTs. fix must have been called before.
+* @param file The data of the file the VMTs were read from.
+* @param peh PE header of the file.
+* @param cache Optional cache for names that are shared between files.
+* @param threads Maximum number of threads.
+**/
+void readExtraInfo(const VMTDir& vmtdir, const unsigned char* file, PeLib::PeHeader32& peh, SymbolCache* cache, unsigned int threads)
+{
+	ExtraInfoState state;
+	fill(vmtdir, state.vmts);
+	state.vmtdir = &vmtdir;
+	state.file = file;
+	state.peh = &peh;
+	state.cache = cache;
+	state.statistics = &currentStatistics();
+	state.next = 0;
+	
+	unsigned int useful = static_cast<unsigned int>(state.vmts.size()) / EXTRAINFO_MIN_VMTS;
+	
+	if (threads > useful) threads = useful;
+	
+	runThreads(threads ? threads : 1, extraInfoWorker, &state);
+}
+
 /**
 * Searches through an entire file and tries to find valid VMTs.
 * @param pefile The file to be read.
 * @param vmtdir All found VMTs will be stored here.
+* @param cache Optional cache for names that are shared between files.
+* @param threads Maximum number of threads that read the extra information.
+* @param lazy If true the fields, methods and properties of each VMT are only
+*        read when they are accessed for the first time (see ensureExtraInfo).
+* @return The number of recognized VMTs.
 **/
-void readVMTs(PeLib::PeFile32& pefile, VMTDir& vmtdir)
+unsigned int readVMTs(PeLib::PeFile32& pefile, VMTDir& vmtdir, SymbolCache* cache, unsigned int threads, bool lazy)
 {
+	PhaseTimer timer(PHASE_SCAN);
+	
     std::ifstream file(pefile.getFileName().c_str(), std::ios::binary);
     
     if (!file)
     {
-		die("Error: Couldn't open file " + pefile.getFileName() + ".");
+		throw std::string("Error: Couldn't open file " + pefile.getFileName() + ".");
 	}
     
     // Read the entire file.
@@ -355,75 +679,223 @@ void readVMTs(PeLib::PeFile32& pefile, VMTDir& vmtdir)
 	std::vector<unsigned char> v(fs);
 	file.read(reinterpret_cast<char*>(&v[0]), fs);
 	
+	PYTHIA_PROBE2(readvmts__start, pefile.getFileName().c_str(), fs);
+	
 	PeLib::PeHeader32& peh = pefile.peHeader();
 	
-	for (unsigned int i=0;i<fs;i+=4) // All VMTs are DWORD-aligned
+	unsigned int candidates = 0;
+	unsigned int recognized = scanVMTs(&v[0], fs, peh, vmtdir, candidates);
+	
+	timer.switchTo(PHASE_FIX);
+	
+	fix(vmtdir);
+	
+	timer.switchTo(PHASE_EXTRAINFO);
+	
+	if (lazy)
 	{
-		PeLib::dword d = *(PeLib::dword*)(&v[i]);
-		PeLib::dword o = pefile.peHeader().rvaToOffset(d - pefile.peHeader().getImageBase());
-
-		if (o == std::numeric_limits<PeLib::dword>::max()) continue;
-
-		if (d >= pefile.peHeader().getImageBase() && o >= 0x200 && i >= 0x200)
+		std::deque<VMT*> vmts;
+		fill(vmtdir, vmts);
+		
+		if (vmts.size())
 		{
-			if (o == i + 76)
+			// The source keeps the file data alive until all VMTs were read.
+			ExtraInfoSource* source = new ExtraInfoSource(v, peh, vmtdir, cache, static_cast<unsigned int>(vmts.size()));
+			
+			for (unsigned int i=0;i<vmts.size();++i)
 			{
-				if (VMT* vmt = readVMT(&v[0], i, peh))
-				{
-					vmt->offset = i;
-					insert(vmtdir, vmt);
-					++g_recognizedVmts;
-				}
+				vmts[i]->pending = source;
 			}
 		}
 	}
+	else
+	{
+		readExtraInfo(vmtdir, &v[0], peh, cache, threads);
+	}
 	
-	fix(vmtdir);
+	PYTHIA_PROBE2(readvmts__done, candidates, recognized);
 	
-	std::deque<VMT*> vmts;
-	fill(vmtdir, vmts);
-	std::for_each(vmts.begin(), vmts.end(), ReadExtraInfo(vmtdir, &v[0], peh));
+	return recognized;
 }
 
+/**
+* Guesses the item class of a collection that's not in the collection table.
+* Collections are usually named after their items (TFooItems holds TFooItem
+* objects, TFooBars holds TFooBarItem objects).
+* @param collection Name of the collection class.
+* @param vmtdir A VMT directory.
+* @return The item class or 0 if no matching class was found.
+**/
+VMT* guessItemClass(const std::string& collection, const VMTDir& vmtdir)
+{
+	if (collection.length() < 2 || collection[collection.length() - 1] != 's') return 0;
+	
+	std::string singular = collection.substr(0, collection.length() - 1);
+	
+	if (VMT* item = find<FindByName>(vmtdir, singular)) return item;
+	
+	return find<FindByName>(vmtdir, singular + "Item");
+}
+
+/**
+* Returns the class of the items of a collection (see collections.cpp).
+* The result is cached in the VMT, so only the first call per class has
+* to search the VMT directory.
+* @param vmt A VMT (may be 0).
+* @param vmtdir A VMT directory.
+* @return The item class if the VMT is a collection, otherwise the VMT itself.
+**/
 VMT* handleCollections(VMT* vmt, const VMTDir& vmtdir)
 {
-	if (vmt && vmt->parent && vmt->parent->name &&
+	if (!vmt) return 0;
+	
+	if (vmt->itemClassKnown) return vmt->itemClass;
+	
+	VMT* item = vmt;
+	
+	if (vmt->parent && vmt->parent->name &&
 		(*vmt->parent->name == "TCollection"
 			|| *vmt->parent->name == "TOwnedCollection"
 			|| *vmt->parent->name == "TActionClientsCollection")
 		)
 	{
-		if (*vmt->name == "TdfsStatusPanels") return find<FindByName>(vmtdir, "TdfsStatusPanel");
-		else if (*vmt->name == "TCoolBands") return find<FindByName>(vmtdir, "TCoolBand");
-		else if (*vmt->name == "TStatusPanels") return find<FindByName>(vmtdir, "TStatusPanel");
-		else if (*vmt->name == "THeaderSections") return find<FindByName>(vmtdir, "THeaderSection");
-		else if (*vmt->name == "TListColumns") return find<FindByName>(vmtdir, "TListColumn");
-		else if (*vmt->name == "TmxStatusPanels") return find<FindByName>(vmtdir, "TmxStatusPanel");
-		else if (*vmt->name == "TActionBars") return find<FindByName>(vmtdir, "TActionBarItem");
-		else if (*vmt->name == "TActionClients") return find<FindByName>(vmtdir, "TActionClientItem");
-		else if (*vmt->name == "TDBGridColumns") return find<FindByName>(vmtdir, "TDBGridColumns");
-		else if (*vmt->name == "TDBGridColumnsEh") return find<FindByName>(vmtdir, "TDBGridColumnsEh");
-		else if (*vmt->name == "TAggregates") return find<FindByName>(vmtdir, "TAggregates");
-		else if (*vmt->name == "TDBSumCollection") return find<FindByName>(vmtdir, "TDBSumCollection");
-		else if (*vmt->name == "TParameters") return find<FindByName>(vmtdir, "TParameter");
-		else throw std::string("Error: Unknown collection " + *vmt->name);
+		if (const std::string* itemname = collectionItemName(*vmt->name))
+		{
+			item = find<FindByName>(vmtdir, *itemname);
+		}
+		else if ((item = guessItemClass(*vmt->name, vmtdir)) != 0)
+		{
+			VERBOSE_PRINT("Assuming that " << *item->name << " is the item class of the collection " << *vmt->name);
+		}
+		else
+		{
+			throw std::string("Error: Unknown collection " + *vmt->name + " (its item class can be given with --collections)");
+		}
 	}
 	
-	return vmt;
+	vmt->itemClass = item;
+	vmt->itemClassKnown = true;
+	
+	return item;
 }
 
+/**
+* Returns the type of a property of a class or of one of its ancestors.
+* Results are memoized per VMT. Since the search continues in the parent,
+* the classes of a hierarchy share the results of their common ancestors.
+* The memos are keyed by name and must be cleared when names change (see
+* clearAttributeTypes).
+* @param vmt The class.
+* @param name The name of the property.
+* @param vmtdir A VMT directory.
+* @return The type of the property or 0 if the property wasn't found.
+**/
 std::string* getAttributeType(const VMT* vmt, const std::string& name, const VMTDir& vmtdir)
 {
+	std::map<std::string, std::string*>::const_iterator Iter = vmt->attributeTypes.find(name);
+	
+	if (Iter != vmt->attributeTypes.end())
+	{
+		addCounter(COUNTER_ATTRIBUTE_CACHE_HITS);
+		return Iter->second;
+	}
+	
+	addCounter(COUNTER_ATTRIBUTE_CACHE_MISSES);
+	
+	ensureExtraInfo(vmt);
+	
+	std::string* type = 0;
+	
 	for (unsigned int i=0;i<vmt->typeinfo.size();++i)
 	{
 		if (*vmt->typeinfo[i].name == name)
 		{
-			return vmt->typeinfo[i].type;
+			type = vmt->typeinfo[i].type;
+			break;
 		}
 	}
 
-	if (vmt->parent) return getAttributeType(handleCollections(vmt->parent, vmtdir), name, vmtdir);
+	if (!type && vmt->parent)
+	{
+		if (const VMT* parent = handleCollections(vmt->parent, vmtdir))
+		{
+			type = getAttributeType(parent, name, vmtdir);
+		}
+	}
+	
+	vmt->attributeTypes[name] = type;
+	
+	return type;
+}
+
+/**
+* Forgets the memoized results of getAttributeType. Must be called after
+* properties were renamed.
+* @param vmtdir The VMTs.
+**/
+void clearAttributeTypes(const VMTDir& vmtdir)
+{
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		vmts[i]->attributeTypes.clear();
+	}
+}
+
+
+/**
+* Reads the fields, methods and properties of a VMT that was left unread by
+* readVMTs. Use ensureExtraInfo instead of calling this function directly.
+* @param vmt The VMT.
+**/
+void readPendingExtraInfo(const VMT* vmt)
+{
+	// The tables are a memoized part of the VMT, so reading them doesn't
+	// really change the VMT.
+	VMT* unread = const_cast<VMT*>(vmt);
 	
-	return 0;
+	ExtraInfoSource* source = unread->pending;
+	unread->pending = 0;
+	
+	// Billed to the extrainfo phase, not to the phase that needs the tables.
+	PhaseTimer timer(PHASE_EXTRAINFO);
+	
+	source->read(unread);
+	addCounter(COUNTER_DEFERRED_VMTS);
 }
 
+/**
+* Reads the fields, methods and properties of all VMTs that were left unread
+* by readVMTs. Everything that processes all VMTs (obfuscating, writing) has
+* to call this first.
+* @param vmtdir The VMTs.
+**/
+void materializeExtraInfo(const VMTDir& vmtdir)
+{
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	std::for_each(vmts.begin(), vmts.end(), &ensureExtraInfo);
+}
+
+/**
+* Releases the file data that's kept for VMTs that were never read. The
+* fields, methods and properties of these VMTs stay empty.
+* @param vmtdir The VMTs.
+**/
+void discardExtraInfo(const VMTDir& vmtdir)
+{
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		if (ExtraInfoSource* source = vmts[i]->pending)
+		{
+			vmts[i]->pending = 0;
+			source->release();
+		}
+	}
+}
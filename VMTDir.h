@@ -12,11 +12,11 @@
 #define VMTPARSER_H
 
 #include "helpers.h"
+#include "strkernels.h"
 
 #include <PeLib.h>
 
-template<typename T>
-bool cmpncs(T s1, T s2);
+#include <map>
 
 /**
 * Stores the property info of a VMT.
@@ -71,6 +71,8 @@ struct FieldInfo
 	}
 };
 
+class ExtraInfoSource;
+
 /**
 * Stores information about a virtual method table.
 **/
@@ -107,10 +109,31 @@ struct VMT
 	unsigned int vmtFreeInstance;
 	unsigned int vmtDestroy;
 	
+	/**
+	* Where the fields, methods and properties are read from if they were
+	* left unread by readVMTs (0 if they were already read).
+	**/
+	ExtraInfoSource* pending;
+	
+	/**
+	* The result of handleCollections for this VMT (valid if itemClassKnown
+	* is true).
+	**/
+	VMT* itemClass;
+	bool itemClassKnown;
+	
+	/**
+	* Memoized results of getAttributeType for this VMT.
+	**/
+	mutable std::map<std::string, std::string*> attributeTypes;
+	
 	VMT()
 	{
 		name = 0;
 		parent = 0;
+		pending = 0;
+		itemClass = 0;
+		itemClassKnown = false;
 	}
 	
 	~VMT()
@@ -124,9 +147,29 @@ struct VMT
 
 typedef std::vector<VMT*> VMTDir;
 
-void readVMTs(PeLib::PeFile32& pefile, VMTDir& vmtparser);
+class SymbolCache;
+
+unsigned int readVMTs(PeLib::PeFile32& pefile, VMTDir& vmtparser, SymbolCache* cache = 0, unsigned int threads = 1, bool lazy = false);
+unsigned int scanVMTs(const unsigned char* file, unsigned int size, PeLib::PeHeader32& peh, VMTDir& vmtdir, unsigned int& candidates);
+void fix(VMTDir& root);
+void readExtraInfo(const VMTDir& vmtdir, const unsigned char* file, PeLib::PeHeader32& peh, SymbolCache* cache = 0, unsigned int threads = 1);
 VMT* handleCollections(VMT* vmt, const VMTDir& vmtdir);
 std::string* getAttributeType(const VMT* vmt, const std::string& name, const VMTDir& vmtdir);
+void clearAttributeTypes(const VMTDir& vmtdir);
+void readPendingExtraInfo(const VMT* vmt);
+void materializeExtraInfo(const VMTDir& vmtdir);
+void discardExtraInfo(const VMTDir& vmtdir);
+
+/**
+* Makes sure that the fields, methods and properties of a VMT were read.
+* Must be called before these tables are accessed if the VMTs were read
+* lazily (see readVMTs). This is not thread-safe.
+* @param vmt The VMT.
+**/
+inline void ensureExtraInfo(const VMT* vmt)
+{
+	if (vmt->pending) readPendingExtraInfo(vmt);
+}
 
 /**
 * Used when searching VMTs by method name.
@@ -135,9 +178,11 @@ struct FindByMethodName
 {
 	static VMT* find(VMT* vmt, const std::string& methodname)
 	{
+		ensureExtraInfo(vmt);
+		
 		for (unsigned int i=0;i<vmt->methods.size();i++)
 		{
-			if (cmpncs(*vmt->methods[i].name, methodname))
+			if (equalsIgnoreCase(*vmt->methods[i].name, methodname))
 			{
 				return vmt;
 			}
@@ -153,6 +198,8 @@ struct FindByPropertyName
 {
 	static VMT* find(VMT* vmt, const std::string& propertyname)
 	{
+		ensureExtraInfo(vmt);
+		
 		for (unsigned int i=0;i<vmt->typeinfo.size();i++)
 		{
 			if (*vmt->typeinfo[i].name == propertyname)
@@ -171,6 +218,8 @@ struct FindByFieldName
 {
 	static VMT* find(VMT* vmt, const std::string& fieldname)
 	{
+		ensureExtraInfo(vmt);
+		
 		for (unsigned int i=0;i<vmt->fields.size();i++)
 		{
 			if (*vmt->fields[i].name == fieldname)
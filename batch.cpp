@@ -0,0 +1,230 @@
+/*
+* batch.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "batch.h"
+#include "pythia.h"
+#include "symcache.h"
+#include "threads.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+/**
+* Determines whether a file name has one of the extensions of Delphi
+* executables (.exe, .dll, .bpl).
+**/
+bool isDelphiExecutable(const std::string& filename)
+{
+	std::string::size_type dot = filename.rfind('.');
+	if (dot == std::string::npos) return false;
+	
+	std::string extension = filename.substr(dot + 1);
+	
+	return equalsIgnoreCase(extension, "exe")
+		|| equalsIgnoreCase(extension, "dll")
+		|| equalsIgnoreCase(extension, "bpl");
+}
+
+/**
+* Determines the files a batch run works on.
+* @param source Either a directory (all executables in the directory are
+*        processed) or a text file that contains one file name per line.
+* @param files The file names are stored here.
+**/
+void collectBatchFiles(const std::string& source, std::vector<std::string>& files)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(source.c_str());
+	bool directory = attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+	bool directory = stat(source.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+
+	if (directory)
+	{
+		std::vector<std::string> names;
+		
+#ifdef _WIN32
+		WIN32_FIND_DATAA fd;
+		HANDLE find = FindFirstFileA((source + "\\*").c_str(), &fd);
+		
+		if (find != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(fd.cFileName);
+			}
+			while (FindNextFileA(find, &fd));
+			
+			FindClose(find);
+		}
+		
+		const std::string separator = "\\";
+#else
+		if (DIR* dir = opendir(source.c_str()))
+		{
+			while (dirent* entry = readdir(dir))
+			{
+				names.push_back(entry->d_name);
+			}
+			
+			closedir(dir);
+		}
+		
+		const std::string separator = "/";
+#endif
+
+		std::sort(names.begin(), names.end());
+		
+		for (unsigned int i=0;i<names.size();++i)
+		{
+			if (isDelphiExecutable(names[i])) files.push_back(source + separator + names[i]);
+		}
+	}
+	else
+	{
+		std::ifstream list(source.c_str());
+		
+		if (!list) throw std::string("Error: Couldn't open file list " + source + ".");
+		
+		std::string line;
+		
+		while (std::getline(list, line))
+		{
+			// Tolerate lists with Windows line breaks.
+			if (line.size() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+			if (line.size()) files.push_back(line);
+		}
+	}
+}
+
+/**
+* Obfuscates a single file of a batch run.
+* @param filename Name of the file.
+* @param cache Cache that's shared between all files of the batch.
+* @param statistics Statistics that are shared between all files of the batch.
+* @param options Settings of the batch run.
+* @param seed Seed of the name generator of the file.
+* @param summary Receives the changes that were made to the file.
+* @param error Receives the error message if the file couldn't be obfuscated.
+* @return True if the file was obfuscated.
+**/
+bool obfuscateFile(const std::string& filename, SymbolCache& cache, Statistics& statistics, const BatchOptions& options, unsigned int seed, PatchSummary& summary, std::string& error)
+{
+	TraceSpan span("file", filename);
+	
+	PythiaOptions settings;
+	settings.checkCollisions = options.checkCollisions;
+	settings.formCacheDirectory = options.formCacheDirectory;
+	settings.collections = options.collections;
+	settings.symbolCache = &cache;
+	settings.statistics = &statistics;
+	settings.seed = seed;
+	
+	// The files are already processed in parallel.
+	settings.threads = 1;
+	
+	try
+	{
+		PythiaContext context(filename, settings);
+		
+		context.scan();
+		context.parseForms();
+		context.synchronize();
+		context.obfuscate(NameMapping());
+		summary = context.store(options.atomicOutput ? filename : "");
+	}
+	catch(const std::string& e)
+	{
+		error = e;
+		return false;
+	}
+	
+	return true;
+}
+
+/**
+* State that's shared by all worker threads of a batch run.
+**/
+struct BatchState
+{
+	const std::vector<std::string>& files;
+	const BatchOptions& options;
+	SymbolCache cache;
+	Statistics* statistics;
+	Mutex outputMutex;
+	volatile unsigned int next;
+	volatile unsigned int failed;
+	
+	BatchState(const std::vector<std::string>& files, const BatchOptions& options)
+		: files(files), options(options), statistics(options.statistics ? options.statistics : &currentStatistics()), next(0), failed(0) {}
+};
+
+/**
+* Worker thread of a batch run. Takes files from the list until all files
+* were processed.
+**/
+void batchWorker(void* argument)
+{
+	BatchState& state = *static_cast<BatchState*>(argument);
+	
+	// The files of this thread share one block of the statistics.
+	StatisticsScope scope(*state.statistics);
+	
+	while (true)
+	{
+		unsigned int index = atomicAdd(state.next, 1);
+		if (index >= state.files.size()) return;
+		
+		PatchSummary summary;
+		std::string error;
+		unsigned int seed = state.options.seed ^ (index * 2654435761u);
+		bool success = obfuscateFile(state.files[index], state.cache, *state.statistics, state.options, seed, summary, error);
+		
+		if (!success) atomicAdd(state.failed, 1);
+		
+		ScopedLock lock(state.outputMutex);
+		
+		if (success) std::cout << "Obfuscated " << state.files[index] << " (" << summary.bytes << " bytes in " << summary.patches << " patches)\n";
+		else std::cout << "Failed " << state.files[index] << ": " << error << "\n";
+	}
+}
+
+/**
+* Obfuscates a number of files in one process.
+* @param files The files to obfuscate.
+* @param options Settings of the batch run.
+* @return Number of files that could not be obfuscated.
+**/
+unsigned int processBatch(const std::vector<std::string>& files, const BatchOptions& options)
+{
+	BatchState state(files, options);
+	
+	unsigned int jobs = options.jobs;
+	
+	if (jobs > files.size()) jobs = static_cast<unsigned int>(files.size());
+	
+	runThreads(jobs ? jobs : 1, batchWorker, &state);
+	
+	return state.failed;
+}
@@ -0,0 +1,54 @@
+/*
+* batch.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "collections.h"
+#include "stats.h"
+
+#include <string>
+#include <vector>
+
+/**
+* Settings of a batch run.
+**/
+struct BatchOptions
+{
+	/// Number of files that are processed in parallel.
+	unsigned int jobs;
+	
+	/// Directory of the form cache (empty if no cache is used).
+	std::string formCacheDirectory;
+	
+	/// Replace the files atomically instead of modifying them in place.
+	bool atomicOutput;
+	
+	/// Leave string values alone that have the same text as a symbol.
+	bool checkCollisions;
+	
+	/// Seed of the name generators (each file gets a different generator).
+	unsigned int seed;
+	
+	/// The item classes of the collections (see readCollectionFile).
+	CollectionTable collections;
+	
+	/// Where the statistics of all files are added (if 0 they're added to the
+	/// statistics of the calling thread).
+	Statistics* statistics;
+	
+	BatchOptions() : jobs(1), atomicOutput(false), checkCollisions(true), seed(0),
+		collections(createCollectionTable()), statistics(0) {}
+};
+
+void collectBatchFiles(const std::string& source, std::vector<std::string>& files);
+unsigned int processBatch(const std::vector<std::string>& files, const BatchOptions& options);
+
+#endif
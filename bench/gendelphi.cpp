@@ -0,0 +1,83 @@
+/*
+* gendelphi.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "synth.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+void printUsage()
+{
+	std::cout << "Usage: gendelphi [options] file\n\n";
+	std::cout << "Options:\n";
+	std::cout << "  -c n  Number of generated classes (default 100)\n";
+	std::cout << "  -d n  Length of the inheritance chains (default 4)\n";
+	std::cout << "  -p n  Published properties per class (default 4)\n";
+	std::cout << "  -m n  Published methods per class (default 4)\n";
+	std::cout << "  -f n  Published fields per class (default 2)\n";
+	std::cout << "  -w n  Number of forms (default 4)\n";
+	std::cout << "  -o n  Components per form (default 20)\n";
+	std::cout << "  -n n  Nesting depth of panels on the forms (default 2)\n";
+	std::cout << "  -s n  Seed (default 1). The same options always generate the same file\n";
+	std::cout << "  --no-collections  Forms without collections (status bars, list views)\n";
+	std::cout << "  --no-lists        Forms without string lists\n";
+	std::cout << "  --no-bitmaps      Forms without bitmaps\n";
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printUsage();
+		return 1;
+	}
+	
+	SynthOptions options;
+	
+	for (int i=1;i<argc - 1;i++)
+	{
+		bool value = i + 1 < argc - 1;
+		
+		if (!strcmp(argv[i], "-c") && value) options.classes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-d") && value) options.depth = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-p") && value) options.properties = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-m") && value) options.methods = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f") && value) options.fields = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w") && value) options.forms = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && value) options.components = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && value) options.nesting = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && value) options.seed = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--no-collections")) options.collections = false;
+		else if (!strcmp(argv[i], "--no-lists")) options.lists = false;
+		else if (!strcmp(argv[i], "--no-bitmaps")) options.bitmaps = false;
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	
+	try
+	{
+		SynthSummary summary = writeDelphiFile(argv[argc - 1], options);
+		
+		std::cout << "Wrote " << argv[argc - 1] << ": " << summary.vmts << " VMTs, " << summary.properties << " properties, "
+			<< summary.methods << " methods, " << summary.fields << " fields, " << summary.forms << " forms, "
+			<< summary.components << " components" << std::endl;
+	}
+	catch(const std::string& e)
+	{
+		std::cout << e << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,678 @@
+/*
+* microbench.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "../helpers.h"
+#include "../VMTDir.h"
+#include "../stats.h"
+#include "../strkernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/// Results of the benchmarked functions are added here so they aren't optimized away.
+volatile unsigned long long g_sink;
+
+/**
+* Controls a single run of a benchmark. The benchmark calls keepRunning
+* until it returns false and does one operation per call.
+**/
+class BenchmarkState
+{
+	private:
+		unsigned long long iterations_;
+		unsigned long long count_;
+		unsigned long long start_;
+		unsigned long long paused_;
+		unsigned long long elapsed_;
+		unsigned long long items_;
+		unsigned long long bytes_;
+		unsigned int range_;
+
+	public:
+		BenchmarkState(unsigned long long iterations, unsigned int range)
+			: iterations_(iterations), count_(0), start_(0), paused_(0), elapsed_(0), items_(0), bytes_(0), range_(range) {}
+
+		bool keepRunning()
+		{
+			if (!count_) start_ = monotonicTime();
+
+			if (count_ < iterations_)
+			{
+				++count_;
+				return true;
+			}
+
+			elapsed_ = monotonicTime() - start_ - paused_;
+			return false;
+		}
+
+		/// Excludes the time until resumeTiming is called (for preparing new input).
+		void pauseTiming() { paused_ -= monotonicTime(); }
+		void resumeTiming() { paused_ += monotonicTime(); }
+
+		unsigned long long iterations() const { return iterations_; }
+		unsigned long long elapsed() const { return elapsed_; }
+		unsigned int range() const { return range_; }
+
+		void setItemsProcessed(unsigned long long items) { items_ = items; }
+		void setBytesProcessed(unsigned long long bytes) { bytes_ = bytes; }
+		unsigned long long itemsProcessed() const { return items_; }
+		unsigned long long bytesProcessed() const { return bytes_; }
+};
+
+typedef void (*BenchmarkFunction)(BenchmarkState&);
+
+/**
+* A registered benchmark.
+**/
+struct Benchmark
+{
+	const char* name;
+	BenchmarkFunction function;
+
+	/// Size parameter of the benchmark (0 if it has none).
+	unsigned int range;
+};
+
+/**
+* Reproducible pseudo random numbers (the benchmarks must do the same work
+* on every run).
+**/
+class Random
+{
+	private:
+		unsigned int state_;
+
+	public:
+		Random(unsigned int seed) : state_(seed) {}
+
+		unsigned int next(unsigned int n)
+		{
+			state_ = state_ * 1103515245 + 12345;
+			return (state_ >> 8) % n;
+		}
+};
+
+/**
+* Generates names that look like the names found in Delphi files: class
+* names (TCustomerEditForm), component names (btnOK, Panel12), properties
+* (Caption, ParentShowHint) and event handlers (FormCreate). Most of them are
+* between 4 and 20 characters long with a few up to 40 characters.
+**/
+std::string delphiName(Random& random)
+{
+	static const char* prefixes[] = { "T", "T", "btn", "lbl", "edt", "pnl", "frm", "", "", "", "" };
+	static const char* words[] = { "Form", "Button", "Caption", "Edit", "Customer", "Main", "Panel", "Show", "Hint",
+		"Parent", "Font", "Color", "List", "Item", "Click", "Create", "Data", "Source", "Status", "Bar", "Tab", "Sheet",
+		"Order", "Grid", "Column", "Width", "Height", "Visible", "Enabled", "OK", "Cancel", "Action", "Image", "Menu" };
+
+	std::string name = prefixes[random.next(sizeof(prefixes) / sizeof(prefixes[0]))];
+
+	unsigned int count = 1 + random.next(3) + (random.next(8) ? 0 : 3);
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		name += words[random.next(sizeof(words) / sizeof(words[0]))];
+	}
+
+	if (!random.next(3)) name += toHexString(random.next(30));
+
+	return name;
+}
+
+/**
+* Generates a number of names.
+**/
+std::vector<std::string> delphiNames(unsigned int count, unsigned int seed)
+{
+	Random random(seed);
+	std::vector<std::string> names;
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		names.push_back(delphiName(random));
+	}
+
+	return names;
+}
+
+/**
+* Builds a VMT hierarchy of the given size with inheritance chains of up to
+* 4 levels, like the hierarchies found in real files.
+**/
+void buildVMTs(unsigned int size, VMTDir& vmtdir, std::vector<VMT*>& all)
+{
+	std::vector<std::string> names = delphiNames(size, 2);
+
+	for (unsigned int i=0;i<size;++i)
+	{
+		VMT* vmt = new VMT;
+		vmt->name = new std::string(names[i] + toHexString(i));
+
+		if (i % 4 == 0)
+		{
+			vmtdir.push_back(vmt);
+		}
+		else
+		{
+			vmt->parent = all.back();
+			all.back()->children.push_back(vmt);
+		}
+
+		all.push_back(vmt);
+	}
+}
+
+void freeVMTs(VMTDir& vmtdir, std::vector<VMT*>& all)
+{
+	for (unsigned int i=0;i<all.size();++i) delete all[i]->name;
+	for (unsigned int i=0;i<vmtdir.size();++i) delete vmtdir[i];
+}
+
+void benchReadPascalString(BenchmarkState& state)
+{
+	std::vector<std::string> names = delphiNames(1024, 1);
+	std::vector<unsigned char> buffer;
+	std::vector<unsigned int> offsets;
+
+	for (unsigned int i=0;i<names.size();++i)
+	{
+		offsets.push_back(static_cast<unsigned int>(buffer.size()));
+		buffer.push_back(static_cast<unsigned char>(names[i].size()));
+		buffer.insert(buffer.end(), names[i].begin(), names[i].end());
+	}
+
+	unsigned long long bytes = 0;
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		std::string str = readPascalString<unsigned char>(&buffer[offsets[i++ & 1023]]);
+		bytes += str.size();
+		g_sink += str.size();
+	}
+
+	state.setItemsProcessed(state.iterations());
+	state.setBytesProcessed(bytes);
+}
+
+/**
+* Names as the scanner checks them. Some of them are garbage.
+**/
+std::vector<std::string> scannedNames()
+{
+	std::vector<std::string> names = delphiNames(1024, 1);
+
+	for (unsigned int i=0;i<names.size();i+=16) names[i][names[i].size() / 2] = '\x90';
+
+	return names;
+}
+
+/**
+* Pairs of names. A quarter of the pairs is equal, a quarter is equal
+* except for the case.
+**/
+void namePairs(std::vector<std::string>& first, std::vector<std::string>& second)
+{
+	first = delphiNames(1024, 1);
+	second = delphiNames(1024, 3);
+
+	for (unsigned int i=0;i<first.size();i+=4)
+	{
+		second[i] = first[i];
+		second[i + 1] = first[i + 1];
+		std::transform(second[i + 1].begin(), second[i + 1].end(), second[i + 1].begin(), (int(*)(int)) tolower);
+	}
+}
+
+void benchVerifyPascalString(BenchmarkState& state)
+{
+	std::vector<std::string> names = scannedNames();
+	unsigned long long bytes = 0;
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		const std::string& name = names[i++ & 1023];
+		g_sink += verifyPascalString<ValidCharacter>(name);
+		bytes += name.size();
+	}
+
+	state.setItemsProcessed(state.iterations());
+	state.setBytesProcessed(bytes);
+}
+
+void benchIsIdentifier(BenchmarkState& state)
+{
+	std::vector<std::string> names = scannedNames();
+	unsigned long long bytes = 0;
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		const std::string& name = names[i++ & 1023];
+		g_sink += isIdentifier(name);
+		bytes += name.size();
+	}
+
+	state.setItemsProcessed(state.iterations());
+	state.setBytesProcessed(bytes);
+}
+
+void benchCmpncs(BenchmarkState& state)
+{
+	std::vector<std::string> first;
+	std::vector<std::string> second;
+	namePairs(first, second);
+
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		unsigned int j = i++ & 1023;
+		g_sink += cmpncs(first[j], second[j]);
+	}
+
+	state.setItemsProcessed(state.iterations());
+}
+
+void benchEqualsIgnoreCase(BenchmarkState& state)
+{
+	std::vector<std::string> first;
+	std::vector<std::string> second;
+	namePairs(first, second);
+
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		unsigned int j = i++ & 1023;
+		g_sink += equalsIgnoreCase(first[j], second[j]);
+	}
+
+	state.setItemsProcessed(state.iterations());
+}
+
+void benchHashIgnoreCase(BenchmarkState& state)
+{
+	std::vector<std::string> names = delphiNames(1024, 1);
+	unsigned long long bytes = 0;
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		const std::string& name = names[i++ & 1023];
+		g_sink += hashIgnoreCase(name);
+		bytes += name.size();
+	}
+
+	state.setItemsProcessed(state.iterations());
+	state.setBytesProcessed(bytes);
+}
+
+void benchFind(BenchmarkState& state)
+{
+	VMTDir vmtdir;
+	std::vector<VMT*> all;
+	buildVMTs(state.range(), vmtdir, all);
+
+	// Every eighth search is for a name that doesn't exist.
+	std::vector<std::string> targets;
+	Random random(4);
+
+	for (unsigned int i=0;i<1024;++i)
+	{
+		targets.push_back(i % 8 ? *all[random.next(state.range())]->name : std::string("TUnknownClass"));
+	}
+
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		g_sink += find<FindByName>(vmtdir, targets[i++ & 1023]) != 0;
+	}
+
+	state.setItemsProcessed(state.iterations());
+
+	freeVMTs(vmtdir, all);
+}
+
+void benchFill(BenchmarkState& state)
+{
+	VMTDir vmtdir;
+	std::vector<VMT*> all;
+	buildVMTs(state.range(), vmtdir, all);
+
+	while (state.keepRunning())
+	{
+		std::deque<VMT*> vmts;
+		fill(vmtdir, vmts);
+		g_sink += vmts.size();
+	}
+
+	state.setItemsProcessed(state.iterations() * state.range());
+
+	freeVMTs(vmtdir, all);
+}
+
+/**
+* Looks up method names (case-insensitive, as for event handlers) or field
+* names (case-sensitive) in the tables of a class with range() entries.
+**/
+void benchGetValue(BenchmarkState& state, bool ignoreCase)
+{
+	std::vector<std::string> names = delphiNames(state.range(), 5);
+	std::vector<MethodInfo> methods(state.range());
+
+	for (unsigned int i=0;i<methods.size();++i) methods[i].name = &names[i];
+
+	std::vector<std::string> targets;
+	Random random(6);
+
+	for (unsigned int i=0;i<1024;++i)
+	{
+		targets.push_back(i % 4 ? names[random.next(state.range())] : std::string("UnknownMethod"));
+	}
+
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		g_sink += getValue(methods, targets[i++ & 1023], ignoreCase) != 0;
+	}
+
+	state.setItemsProcessed(state.iterations());
+}
+
+void benchGetValueExact(BenchmarkState& state)
+{
+	benchGetValue(state, false);
+}
+
+void benchGetValueIgnoreCase(BenchmarkState& state)
+{
+	benchGetValue(state, true);
+}
+
+void benchSplitName(BenchmarkState& state)
+{
+	// Property values like Font.Name, DataSource.DataSet.Active or plain names.
+	std::vector<std::string> parts = delphiNames(1024, 7);
+	std::vector<std::string> values;
+	Random random(8);
+
+	for (unsigned int i=0;i<1024;++i)
+	{
+		std::string value = parts[i];
+		unsigned int segments = random.next(4);
+
+		for (unsigned int j=0;j<segments;++j) value += "." + parts[random.next(1024)];
+
+		values.push_back(value);
+	}
+
+	std::vector<std::vector<std::string*> > names(1024);
+	unsigned int i = 0;
+
+	while (state.keepRunning())
+	{
+		unsigned int j = i++ & 1023;
+
+		// Prepare a new set of input names after all names were split.
+		if (!j)
+		{
+			state.pauseTiming();
+
+			for (unsigned int k=0;k<names.size();++k)
+			{
+				for (unsigned int l=0;l<names[k].size();++l) delete names[k][l];
+				names[k].assign(1, new std::string(values[k]));
+			}
+
+			state.resumeTiming();
+		}
+
+		splitName(names[j]);
+		g_sink += names[j].size();
+	}
+
+	for (unsigned int k=0;k<names.size();++k)
+	{
+		for (unsigned int l=0;l<names[k].size();++l) delete names[k][l];
+	}
+
+	state.setItemsProcessed(state.iterations());
+}
+
+void benchUniqueString(BenchmarkState& state)
+{
+	std::vector<std::string> names = delphiNames(1024, 9);
+	std::set<std::string> strings;
+	unsigned int i = 0;
+	RandomCharacterGenerator generator(1);
+
+	while (state.keepRunning())
+	{
+		unsigned int j = i++ % 8192;
+
+		// A file has a limited number of names.
+		if (!j)
+		{
+			state.pauseTiming();
+			strings.clear();
+			state.resumeTiming();
+		}
+
+		g_sink += uniqueString(static_cast<unsigned int>(names[j & 1023].size()), strings, generator).size();
+	}
+
+	state.setItemsProcessed(state.iterations());
+}
+
+const Benchmark benchmarks[] = {
+	{ "readPascalString", benchReadPascalString, 0 },
+	{ "verifyPascalString", benchVerifyPascalString, 0 },
+	{ "isIdentifier", benchIsIdentifier, 0 },
+	{ "cmpncs", benchCmpncs, 0 },
+	{ "equalsIgnoreCase", benchEqualsIgnoreCase, 0 },
+	{ "hashIgnoreCase", benchHashIgnoreCase, 0 },
+	{ "find<FindByName>", benchFind, 100 },
+	{ "find<FindByName>", benchFind, 1000 },
+	{ "find<FindByName>", benchFind, 10000 },
+	{ "fill", benchFill, 100 },
+	{ "fill", benchFill, 1000 },
+	{ "fill", benchFill, 10000 },
+	{ "getValue", benchGetValueExact, 8 },
+	{ "getValue", benchGetValueExact, 64 },
+	{ "getValue/ignoreCase", benchGetValueIgnoreCase, 8 },
+	{ "getValue/ignoreCase", benchGetValueIgnoreCase, 64 },
+	{ "splitName", benchSplitName, 0 },
+	{ "uniqueString", benchUniqueString, 0 }
+};
+
+/**
+* Measurements of a benchmark.
+**/
+struct Measurement
+{
+	std::string name;
+	unsigned long long iterations;
+
+	/// Nanoseconds per iteration of all repetitions.
+	std::vector<double> times;
+
+	double itemsPerSecond;
+	double bytesPerSecond;
+};
+
+std::string benchmarkName(const Benchmark& benchmark)
+{
+	std::stringstream ss;
+	ss << benchmark.name;
+	if (benchmark.range) ss << "/" << benchmark.range;
+	return ss.str();
+}
+
+/**
+* Runs a benchmark. The number of iterations is increased until a run takes
+* at least the minimum time, then the benchmark is repeated with that number
+* of iterations.
+**/
+Measurement run(const Benchmark& benchmark, double minTime, unsigned int repetitions)
+{
+	Measurement measurement;
+	measurement.name = benchmarkName(benchmark);
+
+	unsigned long long iterations = 1;
+	unsigned long long minimum = static_cast<unsigned long long>(minTime * 1e9);
+
+	while (true)
+	{
+		BenchmarkState state(iterations, benchmark.range);
+		benchmark.function(state);
+
+		if (state.elapsed() >= minimum || iterations >= 1000000000) break;
+
+		// Aim a little above the minimum time so the next run is the last one.
+		double factor = state.elapsed() ? 1.4 * minimum / state.elapsed() : 10;
+		iterations = static_cast<unsigned long long>(iterations * std::min(std::max(factor, 2.0), 100.0));
+	}
+
+	double items = 0;
+	double bytes = 0;
+	double seconds = 0;
+
+	for (unsigned int i=0;i<repetitions;++i)
+	{
+		BenchmarkState state(iterations, benchmark.range);
+		benchmark.function(state);
+
+		measurement.times.push_back(static_cast<double>(state.elapsed()) / iterations);
+
+		items += state.itemsProcessed();
+		bytes += state.bytesProcessed();
+		seconds += state.elapsed() / 1e9;
+	}
+
+	measurement.iterations = iterations;
+	measurement.itemsPerSecond = seconds ? items / seconds : 0;
+	measurement.bytesPerSecond = seconds ? bytes / seconds : 0;
+
+	std::sort(measurement.times.begin(), measurement.times.end());
+
+	return measurement;
+}
+
+double median(const std::vector<double>& sorted)
+{
+	return sorted[sorted.size() / 2];
+}
+
+void writeJson(std::ostream& stream, const std::vector<Measurement>& measurements)
+{
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\n  \"benchmarks\": [";
+
+	for (unsigned int i=0;i<measurements.size();++i)
+	{
+		const Measurement& m = measurements[i];
+
+		stream << (i ? "," : "") << "\n    { \"name\": \"" << m.name << "\", \"iterations\": " << m.iterations
+			<< ", \"real_time\": " << median(m.times) << ", \"min_time\": " << m.times.front()
+			<< ", \"time_unit\": \"ns\", \"items_per_second\": " << m.itemsPerSecond;
+
+		if (m.bytesPerSecond) stream << ", \"bytes_per_second\": " << m.bytesPerSecond;
+
+		stream << " }";
+	}
+
+	stream << "\n  ]\n}\n";
+}
+
+void printUsage()
+{
+	std::cout << "Usage: microbench [options]\n\n";
+	std::cout << "Options:\n";
+	std::cout << "  --filter s       Only runs the benchmarks whose name contains s\n";
+	std::cout << "  --min-time t     Minimum time of a run in seconds (default 0.2)\n";
+	std::cout << "  --repetitions n  Number of runs of each benchmark (default 3)\n";
+	std::cout << "  --json f         Writes the results to f as JSON\n";
+}
+
+int main(int argc, char *argv[])
+{
+	std::string filter;
+	std::string jsonFile;
+	double minTime = 0.2;
+	unsigned int repetitions = 3;
+
+	for (int i=1;i<argc;i++)
+	{
+		bool value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--filter") && value) filter = argv[++i];
+		else if (!strcmp(argv[i], "--min-time") && value) minTime = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--repetitions") && value) repetitions = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--json") && value) jsonFile = argv[++i];
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (!repetitions)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::vector<Measurement> measurements;
+
+	std::cout << std::left << std::setw(32) << "Benchmark" << std::right << std::setw(12) << "Time (ns)"
+		<< std::setw(14) << "Iterations" << std::setw(16) << "Items/s" << std::setw(12) << "MB/s" << "\n";
+	std::cout << std::string(86, '-') << "\n";
+
+	for (unsigned int i=0;i<sizeof(benchmarks) / sizeof(benchmarks[0]);++i)
+	{
+		if (benchmarkName(benchmarks[i]).find(filter) == std::string::npos) continue;
+
+		Measurement m = run(benchmarks[i], minTime, repetitions);
+		measurements.push_back(m);
+
+		std::cout << std::left << std::setw(32) << m.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(12) << median(m.times) << std::setw(14) << m.iterations
+			<< std::setprecision(0) << std::setw(16) << m.itemsPerSecond;
+
+		if (m.bytesPerSecond) std::cout << std::setprecision(1) << std::setw(12) << m.bytesPerSecond / 1e6;
+
+		std::cout << std::endl;
+	}
+
+	if (!jsonFile.empty())
+	{
+		std::ofstream file(jsonFile.c_str());
+		writeJson(file, measurements);
+
+		if (!file)
+		{
+			std::cout << "Error: Couldn't write " << jsonFile << "." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
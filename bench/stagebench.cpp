@@ -0,0 +1,484 @@
+/*
+* stagebench.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "synth.h"
+
+#include "../DFMParser.h"
+#include "../VMTDir.h"
+#include "../collisions.h"
+#include "../obfuscate.h"
+#include "../print.h"
+#include "../pythia.h"
+#include "../stats.h"
+#include "../symcache.h"
+#include "../sync.h"
+#include "../trace.h"
+#include "../write.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <PeLib.h>
+
+/**
+* Number of threads of the extrainfo stage.
+**/
+unsigned int extraInfoThreads = 1;
+
+/**
+* The stages of an obfuscation run that are measured.
+**/
+enum Stage
+{
+	STAGE_SCAN,
+	STAGE_FIX,
+	STAGE_EXTRAINFO,
+	STAGE_DFM,
+	STAGE_SYNC,
+	STAGE_COLLISIONS,
+	STAGE_OBFUSCATE,
+	STAGE_STORE,
+	STAGE_PRINT,
+	STAGE_COUNT
+};
+
+const char* stageName(unsigned int stage)
+{
+	static const char* names[STAGE_COUNT] = { "scan", "fix", "extrainfo", "dfm", "sync", "collisions", "obfuscate", "store", "print" };
+	return names[stage];
+}
+
+/**
+* Output stream buffer that discards everything (used to measure -i).
+**/
+class NullBuffer : public std::streambuf
+{
+	protected:
+		int overflow(int c) { return c; }
+		std::streamsize xsputn(const char*, std::streamsize n) { return n; }
+};
+
+/**
+* A file the stages are measured with.
+**/
+struct Fixture
+{
+	std::string filename;
+	std::string output;
+
+	/// True if the file was generated by the benchmark (it's deleted afterwards).
+	bool generated;
+
+	/// Number of generated classes (0 for files that were given on the command line).
+	unsigned int classes;
+
+	std::vector<unsigned char> data;
+	PeLib::PeFile32* pefile;
+
+	unsigned int vmts;
+	unsigned int properties;
+
+	Fixture() : generated(false), classes(0), pefile(0), vmts(0), properties(0) {}
+};
+
+/**
+* The parsed model of a fixture.
+**/
+struct Model
+{
+	VMTDir vmtdir;
+	DFMData dfmresources;
+	SymbolCache cache;
+	ClassStore* classes;
+
+	Model() : classes(0) {}
+
+	~Model()
+	{
+		release(vmtdir, dfmresources, cache, classes);
+		delete classes;
+	}
+};
+
+/**
+* Measurements of one stage for one fixture.
+**/
+struct Result
+{
+	unsigned int stage;
+	const Fixture* fixture;
+	std::vector<unsigned long long> samples;
+
+	unsigned long long median;
+	unsigned long long p95;
+};
+
+void scan(const Fixture& fixture, Model& model)
+{
+	unsigned int candidates = 0;
+	scanVMTs(&fixture.data[0], static_cast<unsigned int>(fixture.data.size()), fixture.pefile->peHeader(), model.vmtdir, candidates);
+}
+
+void extraInfo(const Fixture& fixture, Model& model)
+{
+	readExtraInfo(model.vmtdir, &fixture.data[0], fixture.pefile->peHeader(), 0, extraInfoThreads);
+}
+
+/**
+* Runs one stage once. Everything that the stage depends on is done before
+* the clock is started.
+* @param stage The stage.
+* @param fixture The file.
+* @return The time the stage took in nanoseconds.
+**/
+unsigned long long runStage(unsigned int stage, const Fixture& fixture)
+{
+	Model model;
+	unsigned long long start = 0;
+
+	if (stage == STAGE_SCAN) start = monotonicTime();
+	scan(fixture, model);
+	if (stage == STAGE_SCAN) return monotonicTime() - start;
+
+	if (stage == STAGE_FIX) start = monotonicTime();
+	fix(model.vmtdir);
+	if (stage == STAGE_FIX) return monotonicTime() - start;
+
+	if (stage == STAGE_EXTRAINFO) start = monotonicTime();
+	extraInfo(fixture, model);
+	if (stage == STAGE_EXTRAINFO) return monotonicTime() - start;
+
+	if (stage == STAGE_DFM) start = monotonicTime();
+	readDFMResources(*fixture.pefile, model.dfmresources);
+	if (stage == STAGE_DFM) return monotonicTime() - start;
+
+	if (stage == STAGE_PRINT)
+	{
+		NullBuffer buffer;
+		std::ostream stream(&buffer);
+
+		start = monotonicTime();
+		model.classes = new ClassStore(model.vmtdir);
+		printModel(stream, *model.classes, model.dfmresources);
+		return monotonicTime() - start;
+	}
+
+	if (stage == STAGE_SYNC) start = monotonicTime();
+	synchronize(model.dfmresources, model.vmtdir);
+	if (stage == STAGE_SYNC) return monotonicTime() - start;
+
+	if (stage == STAGE_COLLISIONS) start = monotonicTime();
+	checkStringCollisions(model.dfmresources, model.vmtdir);
+	if (stage == STAGE_COLLISIONS) return monotonicTime() - start;
+
+	NameMapping previous;
+	NameMapping current;
+
+	// Building the class store is counted as part of the obfuscation.
+	if (stage == STAGE_OBFUSCATE) start = monotonicTime();
+	// Obfuscation uses random names. The benchmark should always do the same work.
+	RandomCharacterGenerator generator(1);
+	model.classes = new ClassStore(model.vmtdir);
+	obfuscate(model.dfmresources, *model.classes, previous, current, generator);
+	if (stage == STAGE_OBFUSCATE) return monotonicTime() - start;
+
+	start = monotonicTime();
+	store(fixture.filename, fixture.output, model.dfmresources, *model.classes, *fixture.pefile);
+	return monotonicTime() - start;
+}
+
+/**
+* Counts the VMTs and properties of a fixture.
+**/
+void describe(Fixture& fixture)
+{
+	Model model;
+
+	scan(fixture, model);
+	fix(model.vmtdir);
+	extraInfo(fixture, model);
+
+	std::deque<VMT*> vmts;
+	fill(model.vmtdir, vmts);
+
+	fixture.vmts = static_cast<unsigned int>(vmts.size());
+
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		fixture.properties += static_cast<unsigned int>(vmts[i]->typeinfo.size());
+	}
+}
+
+/**
+* Reads a fixture file.
+**/
+void load(Fixture& fixture)
+{
+	std::ifstream file(fixture.filename.c_str(), std::ios::binary);
+
+	if (!file) throw std::string("Error: Couldn't open file " + fixture.filename + ".");
+
+	fixture.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	if (fixture.data.empty()) throw std::string("Error: " + fixture.filename + " is empty.");
+
+	fixture.pefile = new PeLib::PeFile32(fixture.filename);
+
+	if (fixture.pefile->readMzHeader() || fixture.pefile->readPeHeader() || fixture.pefile->readResourceDirectory())
+	{
+		throw std::string("Error: " + fixture.filename + " is not a valid PE file.");
+	}
+
+	fixture.output = fixture.filename + ".stagebench";
+
+	describe(fixture);
+}
+
+/**
+* Returns the value below which the given percentage of the sorted samples lie.
+**/
+unsigned long long percentile(const std::vector<unsigned long long>& sorted, unsigned int percent)
+{
+	size_t rank = (sorted.size() * percent + 99) / 100;
+	return sorted[rank ? rank - 1 : 0];
+}
+
+/**
+* Items per second at a given duration.
+**/
+double throughput(double items, unsigned long long nanoseconds)
+{
+	return nanoseconds ? items * 1e9 / nanoseconds : 0;
+}
+
+/**
+* Estimates how the time of a stage grows with the number of VMTs. 1 means
+* linear growth, 2 quadratic growth.
+* @param first Result for the smallest fixture.
+* @param last Result for the largest fixture.
+* @return The exponent or 0 if it can't be estimated.
+**/
+double scalingExponent(const Result& first, const Result& last)
+{
+	if (first.fixture->vmts == last.fixture->vmts || !first.median || !last.median) return 0;
+
+	return std::log(static_cast<double>(last.median) / first.median)
+		/ std::log(static_cast<double>(last.fixture->vmts) / first.fixture->vmts);
+}
+
+void writeJson(std::ostream& stream, const std::vector<Result>& results, const std::vector<Fixture*>& sweep, unsigned int iterations)
+{
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\n  \"iterations\": " << iterations << ",\n  \"benchmarks\": [";
+
+	for (unsigned int i=0;i<results.size();++i)
+	{
+		const Result& r = results[i];
+		const Fixture& f = *r.fixture;
+
+		stream << (i ? "," : "") << "\n    { \"stage\": \"" << stageName(r.stage) << "\", \"file\": \"" << escapeJson(f.filename) << "\""
+			<< ", \"classes\": " << f.classes << ", \"bytes\": " << f.data.size() << ", \"vmts\": " << f.vmts
+			<< ", \"properties\": " << f.properties
+			<< ", \"median_ms\": " << r.median / 1e6 << ", \"p95_ms\": " << r.p95 / 1e6
+			<< ", \"mb_per_s\": " << throughput(f.data.size() / 1e6, r.median)
+			<< ", \"vmts_per_s\": " << throughput(f.vmts, r.median)
+			<< ", \"properties_per_s\": " << throughput(f.properties, r.median) << " }";
+	}
+
+	stream << "\n  ],\n  \"scaling\": [";
+
+	if (sweep.size() > 1)
+	{
+		for (unsigned int stage=0;stage<STAGE_COUNT;++stage)
+		{
+			const Result* first = 0;
+			const Result* last = 0;
+
+			for (unsigned int i=0;i<results.size();++i)
+			{
+				if (results[i].stage != stage) continue;
+				if (results[i].fixture == sweep.front()) first = &results[i];
+				if (results[i].fixture == sweep.back()) last = &results[i];
+			}
+
+			stream << (stage ? "," : "") << "\n    { \"stage\": \"" << stageName(stage) << "\", \"from_vmts\": " << sweep.front()->vmts
+				<< ", \"to_vmts\": " << sweep.back()->vmts << ", \"exponent\": " << scalingExponent(*first, *last) << " }";
+		}
+	}
+
+	stream << "\n  ]\n}\n";
+}
+
+void printUsage()
+{
+	std::cout << "Usage: stagebench [options] [file...]\n\n";
+	std::cout << "Measures each stage of an obfuscation run in isolation. Without files\n";
+	std::cout << "synthetic Delphi files of growing size are generated and measured.\n\n";
+	std::cout << "Options:\n";
+	std::cout << "  -n n  Iterations per stage and file (default 5)\n";
+	std::cout << "  -s l  Comma-separated numbers of classes of the synthetic files\n";
+	std::cout << "        (default 100,1000,10000)\n";
+	std::cout << "  -o f  Writes the results to f as JSON (default: standard output)\n";
+	std::cout << "  -x e  Fails if a stage grows faster than n^e over the synthetic files\n";
+	std::cout << "        (e.g. -x 1.5 catches quadratic behavior)\n";
+	std::cout << "  -j n  Number of threads of the extrainfo stage (default 1)\n";
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int iterations = 5;
+	std::string sizes = "100,1000,10000";
+	std::string jsonFile;
+	double maxExponent = 0;
+
+	std::vector<Fixture*> fixtures;
+	std::vector<Fixture*> sweep;
+
+	for (int i=1;i<argc;i++)
+	{
+		bool value = i + 1 < argc;
+
+		if (!strcmp(argv[i], "-n") && value) iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && value) sizes = argv[++i];
+		else if (!strcmp(argv[i], "-o") && value) jsonFile = argv[++i];
+		else if (!strcmp(argv[i], "-x") && value) maxExponent = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-j") && value) extraInfoThreads = atoi(argv[++i]);
+		else if (argv[i][0] == '-' || !iterations)
+		{
+			printUsage();
+			return 1;
+		}
+		else
+		{
+			fixtures.push_back(new Fixture);
+			fixtures.back()->filename = argv[i];
+		}
+	}
+
+	std::vector<Result> results;
+	int status = EXIT_SUCCESS;
+
+	try
+	{
+		if (fixtures.empty())
+		{
+			std::istringstream list(sizes);
+			std::string size;
+
+			while (std::getline(list, size, ','))
+			{
+				SynthOptions options;
+				options.classes = atoi(size.c_str());
+				options.forms = std::max(1u, options.classes / 250);
+
+				Fixture* fixture = new Fixture;
+				fixture->filename = "stagebench-" + size + ".exe";
+				fixture->generated = true;
+				fixture->classes = options.classes;
+
+				fixtures.push_back(fixture);
+				sweep.push_back(fixture);
+
+				writeDelphiFile(fixture->filename, options);
+			}
+		}
+
+		for (unsigned int i=0;i<fixtures.size();++i)
+		{
+			load(*fixtures[i]);
+		}
+
+		std::cerr << std::left << std::setw(12) << "stage" << std::right << std::setw(10) << "vmts" << std::setw(12) << "median ms"
+			<< std::setw(12) << "p95 ms" << std::setw(10) << "MB/s" << std::setw(12) << "VMTs/s" << "\n";
+
+		for (unsigned int i=0;i<fixtures.size();++i)
+		{
+			for (unsigned int stage=0;stage<STAGE_COUNT;++stage)
+			{
+				Result result;
+				result.stage = stage;
+				result.fixture = fixtures[i];
+
+				for (unsigned int j=0;j<iterations;++j)
+				{
+					result.samples.push_back(runStage(stage, *fixtures[i]));
+				}
+
+				std::vector<unsigned long long> sorted(result.samples);
+				std::sort(sorted.begin(), sorted.end());
+				result.median = percentile(sorted, 50);
+				result.p95 = percentile(sorted, 95);
+
+				results.push_back(result);
+
+				std::cerr << std::left << std::setw(12) << stageName(stage) << std::right << std::setw(10) << fixtures[i]->vmts
+					<< std::fixed << std::setprecision(3) << std::setw(12) << result.median / 1e6 << std::setw(12) << result.p95 / 1e6
+					<< std::setprecision(1) << std::setw(10) << throughput(fixtures[i]->data.size() / 1e6, result.median)
+					<< std::setprecision(0) << std::setw(12) << throughput(fixtures[i]->vmts, result.median) << "\n";
+			}
+		}
+
+		if (jsonFile.empty())
+		{
+			writeJson(std::cout, results, sweep, iterations);
+		}
+		else
+		{
+			std::ofstream file(jsonFile.c_str());
+			writeJson(file, results, sweep, iterations);
+
+			if (!file) throw std::string("Error: Couldn't write " + jsonFile + ".");
+		}
+
+		if (maxExponent > 0 && sweep.size() > 1)
+		{
+			for (unsigned int i=0;i<results.size();++i)
+			{
+				if (results[i].fixture != sweep.back()) continue;
+
+				for (unsigned int j=0;j<results.size();++j)
+				{
+					if (results[j].fixture != sweep.front() || results[j].stage != results[i].stage) continue;
+
+					double exponent = scalingExponent(results[j], results[i]);
+
+					if (exponent > maxExponent)
+					{
+						std::cerr << "Error: " << stageName(results[i].stage) << " grows with n^" << std::setprecision(2) << exponent << "\n";
+						status = EXIT_FAILURE;
+					}
+				}
+			}
+		}
+	}
+	catch(const std::string& e)
+	{
+		std::cerr << e << std::endl;
+		status = EXIT_FAILURE;
+	}
+
+	for (unsigned int i=0;i<fixtures.size();++i)
+	{
+		std::remove(fixtures[i]->output.c_str());
+		if (fixtures[i]->generated) std::remove(fixtures[i]->filename.c_str());
+
+		delete fixtures[i]->pefile;
+		delete fixtures[i];
+	}
+
+	return status;
+}
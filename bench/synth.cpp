@@ -0,0 +1,1001 @@
+/*
+* synth.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "synth.h"
+#include "pechecksum.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+/**
+* Generates synthetic Delphi executables. The files contain the structures
+* Pythia reads in the layout the Delphi compiler uses:
+*
+* - The CODE section contains for each class a class reference, the VMT,
+*   the class name, the class type info with the published properties,
+*   the field table and the method table. Type infos of non-class types
+*   follow the classes.
+* - The .rsrc section contains one RCDATA resource per form with the
+*   binary (TPF0) form data.
+**/
+
+const unsigned int IMAGE_BASE = 0x400000;
+const unsigned int SECTION_ALIGNMENT = 0x1000;
+const unsigned int FILE_ALIGNMENT = 0x200;
+const unsigned int HEADER_SIZE = 0x400;
+const unsigned int CODE_RVA = 0x1000;
+
+unsigned int alignUp(unsigned int value, unsigned int alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+* Pseudo random numbers that are the same on every platform (rand() is not).
+**/
+class SynthRandom
+{
+	private:
+		unsigned int state_;
+
+	public:
+		SynthRandom(unsigned int seed) : state_(seed * 2654435761u + 1) {}
+
+		unsigned int next()
+		{
+			state_ = state_ * 1664525 + 1013904223;
+			return state_ >> 8;
+		}
+
+		/// Returns a number from 0 to n - 1.
+		unsigned int below(unsigned int n)
+		{
+			return n ? next() % n : 0;
+		}
+
+		/// Returns true with the probability percent / 100.
+		bool chance(unsigned int percent)
+		{
+			return below(100) < percent;
+		}
+};
+
+/**
+* A growing little-endian buffer with labels. References to labels are
+* written as virtual addresses once the position of the buffer in the
+* image is known.
+**/
+class SynthBuffer
+{
+	private:
+		struct Fixup
+		{
+			unsigned int position;
+			unsigned int label;
+		};
+
+		std::vector<unsigned int> labels_;
+		std::vector<Fixup> fixups_;
+
+	public:
+		std::vector<unsigned char> data;
+
+		unsigned int size() const { return static_cast<unsigned int>(data.size()); }
+
+		void u8(unsigned int value) { data.push_back(static_cast<unsigned char>(value)); }
+		void u16(unsigned int value) { u8(value); u8(value >> 8); }
+		void u32(unsigned int value) { u16(value); u16(value >> 16); }
+
+		void bytes(const std::string& str) { data.insert(data.end(), str.begin(), str.end()); }
+
+		void pascal(const std::string& str)
+		{
+			u8(static_cast<unsigned int>(str.size()));
+			bytes(str);
+		}
+
+		void align(unsigned int alignment)
+		{
+			while (data.size() % alignment) u8(0);
+		}
+
+		void patch32(unsigned int position, unsigned int value)
+		{
+			for (unsigned int i=0;i<4;++i) data[position + i] = static_cast<unsigned char>(value >> (8 * i));
+		}
+
+		unsigned int newLabel()
+		{
+			labels_.push_back(0xFFFFFFFF);
+			return static_cast<unsigned int>(labels_.size() - 1);
+		}
+
+		/// Places a label at the current position.
+		void place(unsigned int label) { labels_[label] = size(); }
+
+		unsigned int position(unsigned int label) const { return labels_[label]; }
+
+		/// Writes the virtual address of a label.
+		void ref(unsigned int label)
+		{
+			Fixup fixup;
+			fixup.position = size();
+			fixup.label = label;
+			fixups_.push_back(fixup);
+			u32(0);
+		}
+
+		/// Writes the virtual addresses of all referenced labels.
+		void resolve(unsigned int rva)
+		{
+			for (unsigned int i=0;i<fixups_.size();++i)
+			{
+				patch32(fixups_[i].position, IMAGE_BASE + rva + labels_[fixups_[i].label]);
+			}
+		}
+};
+
+/**
+* A published property: its name and the name of its type.
+**/
+struct SynthProperty
+{
+	std::string name;
+	std::string type;
+
+	SynthProperty(const std::string& name, const std::string& type) : name(name), type(type) {}
+};
+
+/**
+* A class with everything that's written to its VMT.
+**/
+struct SynthClass
+{
+	std::string name;
+	int parent;
+	std::vector<SynthProperty> properties;
+	std::vector<std::string> methods;
+	std::vector<std::string> fields;
+
+	unsigned int classref;
+	unsigned int self;
+	unsigned int typeinfo;
+	unsigned int typecell;
+
+	SynthClass(const std::string& name, int parent) : name(name), parent(parent) {}
+};
+
+/**
+* All classes of the generated file.
+**/
+class SynthClasses
+{
+	private:
+		std::map<std::string, unsigned int> index_;
+
+	public:
+		std::vector<SynthClass> classes;
+
+		unsigned int add(const std::string& name, const std::string& parent)
+		{
+			int p = parent.empty() ? -1 : static_cast<int>(index_[parent]);
+			index_[name] = static_cast<unsigned int>(classes.size());
+			classes.push_back(SynthClass(name, p));
+			return static_cast<unsigned int>(classes.size() - 1);
+		}
+
+		SynthClass& operator[](const std::string& name) { return classes[index_[name]]; }
+
+		bool contains(const std::string& name) const { return index_.find(name) != index_.end(); }
+
+		/// Adds published properties given as "Name:Type Name:Type ...".
+		void publish(const std::string& name, const std::string& properties)
+		{
+			std::istringstream ss(properties);
+			std::string property;
+
+			while (ss >> property)
+			{
+				std::string::size_type colon = property.find(':');
+				(*this)[name].properties.push_back(SynthProperty(property.substr(0, colon), property.substr(colon + 1)));
+			}
+		}
+};
+
+/**
+* Adds the VCL classes the forms are built from.
+**/
+void addLibraryClasses(SynthClasses& classes)
+{
+	classes.add("TObject", "");
+	classes.add("TPersistent", "TObject");
+	classes.add("TComponent", "TPersistent");
+	classes.publish("TComponent", "Name:TComponentName Tag:Integer");
+	classes.add("TControl", "TComponent");
+	classes.publish("TControl", "Left:Integer Top:Integer Width:Integer Height:Integer Caption:TCaption Color:TColor "
+		"Font:TFont Visible:Boolean Anchors:TAnchors Hint:string OnClick:TNotifyEvent");
+	classes.add("TWinControl", "TControl");
+	classes.publish("TWinControl", "TabOrder:TTabOrder OnEnter:TNotifyEvent OnExit:TNotifyEvent");
+	classes.add("TScrollingWinControl", "TWinControl");
+	classes.add("TCustomForm", "TScrollingWinControl");
+	classes.publish("TCustomForm", "ClientHeight:Integer ClientWidth:Integer OldCreateOrder:Boolean PixelsPerInch:Integer "
+		"OnCreate:TNotifyEvent OnDestroy:TNotifyEvent");
+	classes.add("TForm", "TCustomForm");
+	classes.publish("TForm", "TextHeight:Integer");
+	classes.add("TFont", "TPersistent");
+	classes.publish("TFont", "Charset:TFontCharset Color:TColor Height:Integer Name:TFontName Style:TFontStyles");
+	classes.add("TButton", "TWinControl");
+	classes.publish("TButton", "Default:Boolean ModalResult:TModalResult");
+	classes.add("TEdit", "TWinControl");
+	classes.publish("TEdit", "Text:TCaption ReadOnly:Boolean OnChange:TNotifyEvent");
+	classes.add("TLabel", "TControl");
+	classes.publish("TLabel", "Transparent:Boolean");
+	classes.add("TPanel", "TWinControl");
+	classes.publish("TPanel", "Align:TAlign BevelOuter:TBevelCut");
+	classes.add("TStrings", "TPersistent");
+	classes.add("TListBox", "TWinControl");
+	classes.publish("TListBox", "Items:TStrings OnDblClick:TNotifyEvent");
+	classes.add("TCollection", "TPersistent");
+	classes.add("TCollectionItem", "TPersistent");
+	classes.add("TStatusPanel", "TCollectionItem");
+	classes.publish("TStatusPanel", "Alignment:TAlignment Text:string Width:Integer");
+	classes.add("TStatusPanels", "TCollection");
+	classes.add("TStatusBar", "TWinControl");
+	classes.publish("TStatusBar", "Panels:TStatusPanels SimplePanel:Boolean");
+	classes.add("TListColumn", "TCollectionItem");
+	classes.publish("TListColumn", "Caption:TCaption Width:TWidth");
+	classes.add("TListColumns", "TCollection");
+	classes.add("TListView", "TWinControl");
+	classes.publish("TListView", "Columns:TListColumns ViewStyle:TViewStyle OnSelectItem:TLVSelectItemEvent");
+	classes.add("TGraphic", "TPersistent");
+	classes.add("TBitmap", "TGraphic");
+	classes.add("TPicture", "TPersistent");
+	classes.add("TImage", "TControl");
+	classes.publish("TImage", "Picture:TPicture Stretch:Boolean");
+}
+
+const char* WORDS[] = {
+	"Customer", "Order", "Invoice", "Account", "Report", "Item", "Line", "Data", "Module", "View",
+	"Frame", "Grid", "Tree", "Node", "List", "Action", "Manager", "Helper", "Cache", "Query",
+	"Record", "Field", "Value", "State", "Event", "Handler", "Filter", "Detail", "Summary", "Price",
+	"Stock", "Supplier", "Address", "Contact", "Payment", "Tax", "Period", "Journal", "Entry", "Batch"
+};
+
+const char* SIMPLE_TYPES[] = { "Integer", "string", "Boolean", "TColor", "TNotifyEvent", "Cardinal", "Double", "TDateTime" };
+
+std::string word(SynthRandom& random)
+{
+	return WORDS[random.below(sizeof(WORDS) / sizeof(WORDS[0]))];
+}
+
+std::string number(unsigned int n)
+{
+	std::ostringstream ss;
+	ss << n;
+	return ss.str();
+}
+
+/**
+* Creates a name from random words that's not yet in the set of names.
+**/
+std::string uniqueName(SynthRandom& random, const std::string& prefix, unsigned int words, std::set<std::string>& names)
+{
+	std::string name = prefix;
+	for (unsigned int i=0;i<words;++i) name += word(random);
+
+	std::string candidate = name;
+
+	for (unsigned int i=2;!names.insert(candidate).second;++i) candidate = name + number(i);
+
+	return candidate;
+}
+
+/**
+* Adds the generated classes. They form inheritance chains of the given
+* depth that start at TObject, TPersistent or TComponent.
+**/
+void addGeneratedClasses(SynthClasses& classes, const SynthOptions& options, SynthRandom& random, std::set<std::string>& classnames)
+{
+	static const char* roots[] = { "TObject", "TPersistent", "TComponent" };
+
+	unsigned int depth = options.depth ? options.depth : 1;
+	std::string parent;
+
+	for (unsigned int i=0;i<options.classes;++i)
+	{
+		if (i % depth == 0) parent = roots[random.below(3)];
+
+		std::string name = uniqueName(random, "T", 2 + random.below(2), classnames);
+		classes.add(name, parent);
+
+		SynthClass& cls = classes[name];
+		std::set<std::string> members;
+
+		for (unsigned int j=0;j<options.properties;++j)
+		{
+			std::string type;
+
+			// Some properties have class types. They reference classes that already exist.
+			if (random.chance(25) && i) type = classes.classes[classes.classes.size() - 1 - random.below(std::min(i, 50u))].name;
+			else type = SIMPLE_TYPES[random.below(sizeof(SIMPLE_TYPES) / sizeof(SIMPLE_TYPES[0]))];
+
+			cls.properties.push_back(SynthProperty(uniqueName(random, "", 1 + random.below(2), members), type));
+		}
+
+		for (unsigned int j=0;j<options.methods;++j)
+		{
+			static const char* verbs[] = { "Do", "Handle", "Update", "Load", "Save", "Check" };
+			cls.methods.push_back(uniqueName(random, verbs[random.below(6)], 1 + random.below(2), members));
+		}
+
+		for (unsigned int j=0;j<options.fields;++j)
+		{
+			cls.fields.push_back(uniqueName(random, "", 1 + random.below(2), members));
+		}
+
+		parent = name;
+	}
+}
+
+/**
+* Writes the binary form data of one form.
+**/
+class FormWriter
+{
+	private:
+		const SynthOptions& options_;
+		SynthRandom& random_;
+		SynthClass& form_;
+		unsigned int remaining_;
+		std::map<std::string, unsigned int> counters_;
+		SynthSummary& summary_;
+
+		void integer(int value)
+		{
+			if (value >= -128 && value <= 127)
+			{
+				data.u8(2);
+				data.u8(static_cast<unsigned int>(value));
+			}
+			else if (value >= -32768 && value <= 32767)
+			{
+				data.u8(3);
+				data.u16(static_cast<unsigned int>(value));
+			}
+			else
+			{
+				data.u8(4);
+				data.u32(static_cast<unsigned int>(value));
+			}
+		}
+
+		void intProperty(const std::string& name, int value) { data.pascal(name); integer(value); }
+		void stringProperty(const std::string& name, const std::string& value) { data.pascal(name); data.u8(7); data.pascal(value); }
+		void identProperty(const std::string& name, const std::string& value) { data.pascal(name); data.u8(6); data.pascal(value); }
+		void boolProperty(const std::string& name, bool value) { data.pascal(name); data.u8(value ? 9 : 8); }
+
+		void setProperty(const std::string& name, const std::string& values)
+		{
+			data.pascal(name);
+			data.u8(11);
+
+			std::istringstream ss(values);
+			std::string value;
+			while (ss >> value) data.pascal(value);
+
+			data.u8(0);
+		}
+
+		/// Writes the properties that all controls have.
+		void controlProperties(bool wincontrol)
+		{
+			intProperty("Left", random_.below(600));
+			intProperty("Top", random_.below(400));
+			intProperty("Width", 20 + random_.below(200));
+			intProperty("Height", 20 + random_.below(100));
+
+			if (random_.chance(20)) setProperty("Anchors", "akLeft akTop akRight");
+			if (random_.chance(10)) boolProperty("Visible", false);
+			if (random_.chance(20)) stringProperty("Hint", "Hint for " + word(random_));
+			if (wincontrol) intProperty("TabOrder", random_.below(20));
+		}
+
+		/// Adds a published event handler to the form class.
+		void event(const std::string& property, const std::string& component, const std::string& suffix)
+		{
+			form_.methods.push_back(component + suffix);
+			identProperty(property, component + suffix);
+		}
+
+		void beginComponent(const std::string& classname)
+		{
+			std::string name = classname.substr(1) + number(++counters_[classname]);
+
+			form_.fields.push_back(name);
+			++summary_.components;
+
+			data.pascal(classname);
+			data.pascal(name);
+		}
+
+		void components(unsigned int depth)
+		{
+			unsigned int count = depth ? 1 + random_.below(4) : remaining_;
+
+			for (unsigned int i=0;i<count && remaining_;++i)
+			{
+				--remaining_;
+				component(depth);
+			}
+
+			data.u8(0);
+		}
+
+		void component(unsigned int depth)
+		{
+			std::vector<std::string> kinds;
+			kinds.push_back("TButton");
+			kinds.push_back("TEdit");
+			kinds.push_back("TLabel");
+			if (depth < options_.nesting) kinds.push_back("TPanel");
+			if (options_.lists) kinds.push_back("TListBox");
+			if (options_.collections) kinds.push_back("TStatusBar");
+			if (options_.collections) kinds.push_back("TListView");
+			if (options_.bitmaps) kinds.push_back("TImage");
+
+			std::string kind = kinds[random_.below(static_cast<unsigned int>(kinds.size()))];
+
+			beginComponent(kind);
+
+			std::string name = form_.fields.back();
+
+			if (kind == "TButton")
+			{
+				controlProperties(true);
+				// Delphi captions new buttons with their name and that's often left alone.
+				stringProperty("Caption", random_.chance(25) ? name : word(random_) + " " + word(random_));
+				event("OnClick", name, "Click");
+			}
+			else if (kind == "TEdit")
+			{
+				controlProperties(true);
+				stringProperty("Text", "");
+				if (random_.chance(50)) event("OnChange", name, "Change");
+			}
+			else if (kind == "TLabel")
+			{
+				controlProperties(false);
+				stringProperty("Caption", word(random_) + ":");
+				if (random_.chance(30)) boolProperty("Transparent", true);
+			}
+			else if (kind == "TPanel")
+			{
+				controlProperties(true);
+				identProperty("BevelOuter", "bvNone");
+				stringProperty("Caption", "");
+			}
+			else if (kind == "TListBox")
+			{
+				controlProperties(true);
+
+				data.pascal("Items.Strings");
+				data.u8(1);
+				for (unsigned int i=random_.below(6);i>0;--i) { data.u8(7); data.pascal(word(random_) + " " + number(i)); }
+				data.u8(0);
+
+				event("OnDblClick", name, "DblClick");
+			}
+			else if (kind == "TStatusBar")
+			{
+				intProperty("Left", 0);
+				intProperty("Top", 400);
+
+				data.pascal("Panels");
+				data.u8(14);
+				for (unsigned int i=1 + random_.below(4);i>0;--i)
+				{
+					data.u8(1);
+					intProperty("Width", 50 + random_.below(200));
+					if (random_.chance(50)) stringProperty("Text", word(random_) + " " + word(random_));
+					data.u8(0);
+				}
+				data.u8(0);
+
+				boolProperty("SimplePanel", false);
+			}
+			else if (kind == "TListView")
+			{
+				controlProperties(true);
+
+				data.pascal("Columns");
+				data.u8(14);
+				for (unsigned int i=1 + random_.below(5);i>0;--i)
+				{
+					data.u8(1);
+					stringProperty("Caption", word(random_));
+					intProperty("Width", 40 + random_.below(200));
+					data.u8(0);
+				}
+				data.u8(0);
+
+				identProperty("ViewStyle", "vsReport");
+				if (random_.chance(50)) event("OnSelectItem", name, "SelectItem");
+			}
+			else if (kind == "TImage")
+			{
+				controlProperties(false);
+
+				// The binary data of a picture starts with the class name of the graphic.
+				std::string bitmap = "BM";
+				for (unsigned int i=16 + random_.below(240);i>0;--i) bitmap += static_cast<char>(random_.below(256));
+
+				data.pascal("Picture.Data");
+				data.u8(10);
+				data.u32(static_cast<unsigned int>(8 + bitmap.size()));
+				data.pascal("TBitmap");
+				data.bytes(bitmap);
+
+				boolProperty("Stretch", random_.chance(50));
+			}
+
+			// End of the properties.
+			data.u8(0);
+
+			if (kind == "TPanel") components(depth + 1);
+			else data.u8(0);
+		}
+
+	public:
+		SynthBuffer data;
+
+		FormWriter(const SynthOptions& options, SynthRandom& random, SynthClass& form, SynthSummary& summary)
+			: options_(options), random_(random), form_(form), remaining_(options.components), summary_(summary) {}
+
+		void write(const std::string& caption)
+		{
+			data.bytes("TPF0");
+			data.pascal(form_.name);
+			data.pascal(form_.name.substr(1));
+
+			intProperty("Left", 100 + random_.below(200));
+			intProperty("Top", 100 + random_.below(200));
+			intProperty("Width", 640);
+			intProperty("Height", 480);
+			stringProperty("Caption", caption);
+			intProperty("ClientHeight", 446);
+			intProperty("ClientWidth", 632);
+			identProperty("Color", "clBtnFace");
+			identProperty("Font.Charset", "DEFAULT_CHARSET");
+			identProperty("Font.Color", "clWindowText");
+			intProperty("Font.Height", -11);
+			stringProperty("Font.Name", "MS Sans Serif");
+			setProperty("Font.Style", "");
+			boolProperty("OldCreateOrder", false);
+			event("OnCreate", "Form", "Create");
+			intProperty("PixelsPerInch", 96);
+			intProperty("TextHeight", 13);
+			data.u8(0);
+
+			components(0);
+		}
+};
+
+/**
+* Writes the VMT, the class name, the type info, the field table and the
+* method table of a class.
+**/
+void writeClass(SynthBuffer& code, SynthClass& cls, SynthClasses& classes, std::map<std::string, unsigned int>& typecells, unsigned int codeLabel)
+{
+	unsigned int name = code.newLabel();
+	unsigned int fields = cls.fields.empty() ? 0 : code.newLabel();
+	unsigned int methods = cls.methods.empty() ? 0 : code.newLabel();
+
+	code.align(4);
+
+	// The class reference that vmtParent of derived classes points to.
+	code.place(cls.classref);
+	code.ref(cls.self);
+
+	code.ref(cls.self);					// vmtSelfPtr
+	code.u32(0);						// vmtIntfTable
+	code.u32(0);						// vmtAutoTable
+	code.u32(0);						// vmtInitTable
+	code.ref(cls.typeinfo);				// vmtTypeInfo
+	if (fields) code.ref(fields); else code.u32(0);
+	if (methods) code.ref(methods); else code.u32(0);
+	code.u32(0);						// vmtDynamicTable
+	code.ref(name);						// vmtClassName
+	code.u32(12 + 4 * static_cast<unsigned int>(cls.fields.size()));	// vmtInstanceSize
+	if (cls.parent >= 0) code.ref(classes.classes[cls.parent].classref); else code.u32(0);
+
+	for (unsigned int i=0;i<8;++i) code.ref(codeLabel);	// vmtSafeCallException ... vmtDestroy
+
+	code.place(cls.self);
+
+	// Virtual methods declared by the class.
+	code.ref(codeLabel);
+	code.ref(codeLabel);
+
+	code.place(name);
+	code.pascal(cls.name);
+
+	code.align(4);
+	code.place(cls.typecell);
+	code.ref(cls.typeinfo);
+	code.place(cls.typeinfo);
+	code.u8(7);							// tkClass
+	code.pascal(cls.name);
+	code.ref(cls.self);					// ClassType
+	if (cls.parent >= 0) code.ref(classes.classes[cls.parent].typecell); else code.u32(0);
+	code.u16(static_cast<unsigned int>(cls.properties.size()));
+	code.pascal("Synth");				// Unit name
+	code.u16(static_cast<unsigned int>(cls.properties.size()));
+
+	for (unsigned int i=0;i<cls.properties.size();++i)
+	{
+		const SynthProperty& property = cls.properties[i];
+
+		std::map<std::string, unsigned int>::iterator Iter = typecells.find(property.type);
+
+		if (Iter == typecells.end())
+		{
+			Iter = typecells.insert(std::make_pair(property.type, classes.contains(property.type) ? classes[property.type].typecell : code.newLabel())).first;
+		}
+
+		code.ref(Iter->second);			// PropType
+		code.u32(0xFF000000 | (4 * i));	// GetProc
+		code.u32(0xFF000000 | (4 * i));	// SetProc
+		code.u32(1);					// StoredProc
+		code.u32(0x80000000);			// Index
+		code.u32(0x80000000);			// Default
+		code.u16(i);					// NameIndex
+		code.pascal(property.name);
+	}
+
+	if (fields)
+	{
+		code.align(4);
+		code.place(fields);
+		code.u16(static_cast<unsigned int>(cls.fields.size()));
+		code.u32(0);					// Field class table
+
+		for (unsigned int i=0;i<cls.fields.size();++i)
+		{
+			code.u32(12 + 4 * i);		// Offset of the field
+			code.u16(0);				// Index in the field class table
+			code.pascal(cls.fields[i]);
+		}
+	}
+
+	if (methods)
+	{
+		code.align(4);
+		code.place(methods);
+		code.u16(static_cast<unsigned int>(cls.methods.size()));
+
+		for (unsigned int i=0;i<cls.methods.size();++i)
+		{
+			code.u16(2 + 4 + 1 + static_cast<unsigned int>(cls.methods[i].size()));
+			code.ref(codeLabel);
+			code.pascal(cls.methods[i]);
+		}
+	}
+}
+
+/**
+* Writes the type infos of all types that are not classes.
+**/
+void writeSimpleTypes(SynthBuffer& code, const std::map<std::string, unsigned int>& typecells, SynthClasses& classes)
+{
+	for (std::map<std::string, unsigned int>::const_iterator Iter = typecells.begin(); Iter != typecells.end(); ++Iter)
+	{
+		if (classes.contains(Iter->first)) continue;
+
+		unsigned int typeinfo = code.newLabel();
+
+		code.align(4);
+		code.place(Iter->second);
+		code.ref(typeinfo);
+		code.place(typeinfo);
+		code.u8(Iter->first == "string" ? 10 : 1);	// tkLString or tkInteger
+		code.pascal(Iter->first);
+		code.u8(0);
+		code.u32(0);
+	}
+}
+
+/**
+* Writes the resource directory with one RCDATA resource per form.
+* @param rsrc The resource section.
+* @param rva Relative virtual address of the resource section.
+* @param names Resource names of the forms.
+* @param forms Form data.
+**/
+void writeResources(SynthBuffer& rsrc, unsigned int rva, const std::vector<std::string>& names, const std::vector<std::vector<unsigned char> >& forms)
+{
+	unsigned int count = static_cast<unsigned int>(forms.size());
+
+	// Directory of the resource types, directory of the names, directories of the languages, data entries.
+	unsigned int typeDirectory = 16 + 8;
+	unsigned int languageDirectories = typeDirectory + 16 + 8 * count;
+	unsigned int dataEntries = languageDirectories + count * (16 + 8);
+	unsigned int strings = dataEntries + count * 16;
+
+	std::vector<unsigned int> nameOffsets;
+	unsigned int position = strings;
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		nameOffsets.push_back(position);
+		position += 2 + 2 * static_cast<unsigned int>(names[i].size());
+	}
+
+	unsigned int data = alignUp(position, 8);
+
+	// Root directory: one type (RT_RCDATA).
+	rsrc.u32(0); rsrc.u32(0); rsrc.u16(0); rsrc.u16(0); rsrc.u16(0); rsrc.u16(1);
+	rsrc.u32(10);
+	rsrc.u32(0x80000000 | typeDirectory);
+
+	// Names of the resources. Named entries are sorted by name.
+	rsrc.u32(0); rsrc.u32(0); rsrc.u16(0); rsrc.u16(0); rsrc.u16(count); rsrc.u16(0);
+	for (unsigned int i=0;i<count;++i)
+	{
+		rsrc.u32(0x80000000 | nameOffsets[i]);
+		rsrc.u32(0x80000000 | (languageDirectories + i * 24));
+	}
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		rsrc.u32(0); rsrc.u32(0); rsrc.u16(0); rsrc.u16(0); rsrc.u16(0); rsrc.u16(1);
+		rsrc.u32(0);
+		rsrc.u32(dataEntries + i * 16);
+	}
+
+	std::vector<unsigned int> dataOffsets;
+	position = data;
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		dataOffsets.push_back(position);
+		position = alignUp(position + static_cast<unsigned int>(forms[i].size()), 8);
+	}
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		rsrc.u32(rva + dataOffsets[i]);
+		rsrc.u32(static_cast<unsigned int>(forms[i].size()));
+		rsrc.u32(0);
+		rsrc.u32(0);
+	}
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		rsrc.u16(static_cast<unsigned int>(names[i].size()));
+		for (unsigned int j=0;j<names[i].size();++j) rsrc.u16(static_cast<unsigned char>(names[i][j]));
+	}
+
+	for (unsigned int i=0;i<count;++i)
+	{
+		rsrc.align(8);
+		rsrc.data.insert(rsrc.data.end(), forms[i].begin(), forms[i].end());
+	}
+}
+
+/**
+* Writes the DOS header, the PE header and the section headers.
+**/
+void writeHeaders(SynthBuffer& headers, const SynthBuffer& code, const SynthBuffer& rsrc, unsigned int rsrcRva)
+{
+	unsigned int codeRaw = alignUp(code.size(), FILE_ALIGNMENT);
+	unsigned int rsrcRaw = alignUp(rsrc.size(), FILE_ALIGNMENT);
+
+	headers.u16(0x5A4D);				// MZ
+	headers.data.resize(0x3C);
+	headers.u32(0x80);					// e_lfanew
+	headers.data.resize(0x80);
+
+	headers.u32(0x4550);				// PE\0\0
+	headers.u16(0x14C);					// Machine: i386
+	headers.u16(2);						// Number of sections
+	headers.u32(0x2A425E19);			// Timestamp (the one Delphi always writes)
+	headers.u32(0);
+	headers.u32(0);
+	headers.u16(0xE0);					// Size of the optional header
+	headers.u16(0x818E);				// Characteristics
+
+	headers.u16(0x10B);					// PE32
+	headers.u8(2);						// Linker version
+	headers.u8(25);
+	headers.u32(codeRaw);				// Size of code
+	headers.u32(rsrcRaw);				// Size of initialized data
+	headers.u32(0);
+	headers.u32(CODE_RVA);				// Entry point
+	headers.u32(CODE_RVA);				// Base of code
+	headers.u32(rsrcRva);				// Base of data
+	headers.u32(IMAGE_BASE);
+	headers.u32(SECTION_ALIGNMENT);
+	headers.u32(FILE_ALIGNMENT);
+	headers.u16(4); headers.u16(0);		// OS version
+	headers.u16(0); headers.u16(0);		// Image version
+	headers.u16(4); headers.u16(0);		// Subsystem version
+	headers.u32(0);
+	headers.u32(alignUp(rsrcRva + rsrc.size(), SECTION_ALIGNMENT));	// Size of image
+	headers.u32(HEADER_SIZE);
+	headers.u32(0);						// Checksum, written later
+	headers.u16(2);						// Subsystem: Windows GUI
+	headers.u16(0);
+	headers.u32(0x100000);				// Stack reserve
+	headers.u32(0x4000);				// Stack commit
+	headers.u32(0x100000);				// Heap reserve
+	headers.u32(0x1000);				// Heap commit
+	headers.u32(0);
+	headers.u32(16);					// Number of data directories
+
+	for (unsigned int i=0;i<16;++i)
+	{
+		headers.u32(i == 2 ? rsrcRva : 0);
+		headers.u32(i == 2 ? rsrc.size() : 0);
+	}
+
+	headers.bytes(std::string("CODE\0\0\0\0", 8));
+	headers.u32(code.size());
+	headers.u32(CODE_RVA);
+	headers.u32(codeRaw);
+	headers.u32(HEADER_SIZE);
+	headers.u32(0); headers.u32(0); headers.u16(0); headers.u16(0);
+	headers.u32(0x60000020);
+
+	headers.bytes(std::string(".rsrc\0\0\0", 8));
+	headers.u32(rsrc.size());
+	headers.u32(rsrcRva);
+	headers.u32(rsrcRaw);
+	headers.u32(HEADER_SIZE + codeRaw);
+	headers.u32(0); headers.u32(0); headers.u16(0); headers.u16(0);
+	headers.u32(0x50000040);
+
+	headers.data.resize(HEADER_SIZE);
+}
+
+/**
+* Generates a synthetic Delphi executable.
+* @param options Describes the file.
+* @param image Receives the file.
+* @return What was generated.
+**/
+SynthSummary generateDelphiFile(const SynthOptions& options, std::vector<unsigned char>& image)
+{
+	SynthRandom random(options.seed);
+	SynthSummary summary;
+	SynthClasses classes;
+	std::set<std::string> classnames;
+
+	addLibraryClasses(classes);
+
+	for (unsigned int i=0;i<classes.classes.size();++i) classnames.insert(classes.classes[i].name);
+
+	addGeneratedClasses(classes, options, random, classnames);
+
+	// The forms add their classes and the fields and methods of those classes.
+	std::vector<std::vector<unsigned char> > forms;
+	std::vector<std::string> resourceNames;
+
+	for (unsigned int i=0;i<options.forms;++i)
+	{
+		std::string name = uniqueName(random, "T", 1, classnames) + "Form";
+		classes.add(name, "TForm");
+
+		FormWriter writer(options, random, classes[name], summary);
+		writer.write(word(random) + " " + number(i + 1));
+
+		forms.push_back(writer.data.data);
+		// Delphi names the resource of a form after its class.
+		std::string resourceName = name.substr(1);
+		for (unsigned int j=0;j<resourceName.size();++j) resourceName[j] = static_cast<char>(toupper(resourceName[j]));
+		resourceNames.push_back(resourceName);
+
+		++summary.forms;
+	}
+
+	// The resource directory expects sorted names.
+	std::vector<std::pair<std::string, unsigned int> > order;
+	for (unsigned int i=0;i<resourceNames.size();++i) order.push_back(std::make_pair(resourceNames[i], i));
+	std::sort(order.begin(), order.end());
+
+	std::vector<std::string> sortedNames;
+	std::vector<std::vector<unsigned char> > sortedForms;
+
+	for (unsigned int i=0;i<order.size();++i)
+	{
+		sortedNames.push_back(order[i].first);
+		sortedForms.push_back(forms[order[i].second]);
+	}
+
+	SynthBuffer code;
+
+	// A single ret instruction is the code of all methods.
+	unsigned int codeLabel = code.newLabel();
+	code.place(codeLabel);
+	code.u8(0xC3);
+	code.data.resize(16, 0xCC);
+
+	for (unsigned int i=0;i<classes.classes.size();++i)
+	{
+		SynthClass& cls = classes.classes[i];
+		cls.classref = code.newLabel();
+		cls.self = code.newLabel();
+		cls.typeinfo = code.newLabel();
+		cls.typecell = code.newLabel();
+	}
+
+	std::map<std::string, unsigned int> typecells;
+
+	for (unsigned int i=0;i<classes.classes.size();++i)
+	{
+		SynthClass& cls = classes.classes[i];
+
+		writeClass(code, cls, classes, typecells, codeLabel);
+
+		++summary.vmts;
+		summary.properties += static_cast<unsigned int>(cls.properties.size());
+		summary.methods += static_cast<unsigned int>(cls.methods.size());
+		summary.fields += static_cast<unsigned int>(cls.fields.size());
+	}
+
+	writeSimpleTypes(code, typecells, classes);
+
+	code.align(4);
+	code.resolve(CODE_RVA);
+
+	unsigned int rsrcRva = alignUp(CODE_RVA + code.size(), SECTION_ALIGNMENT);
+
+	SynthBuffer rsrc;
+	writeResources(rsrc, rsrcRva, sortedNames, sortedForms);
+
+	SynthBuffer headers;
+	writeHeaders(headers, code, rsrc, rsrcRva);
+
+	image = headers.data;
+	image.insert(image.end(), code.data.begin(), code.data.end());
+	image.resize(alignUp(static_cast<unsigned int>(image.size()), FILE_ALIGNMENT));
+	image.insert(image.end(), rsrc.data.begin(), rsrc.data.end());
+	image.resize(alignUp(static_cast<unsigned int>(image.size()), FILE_ALIGNMENT));
+
+	unsigned int checksum = computeChecksum(&image[0], image.size());
+	unsigned int offset = checksumOffset(&image[0], image.size());
+
+	for (unsigned int i=0;i<4;++i) image[offset + i] = static_cast<unsigned char>(checksum >> (8 * i));
+
+	return summary;
+}
+
+/**
+* Generates a synthetic Delphi executable and writes it to a file.
+* @param filename Name of the file.
+* @param options Describes the file.
+* @return What was generated.
+**/
+SynthSummary writeDelphiFile(const std::string& filename, const SynthOptions& options)
+{
+	std::vector<unsigned char> image;
+	SynthSummary summary = generateDelphiFile(options, image);
+
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&image[0]), image.size());
+
+	if (!file) throw std::string("Error: Couldn't write file " + filename + ".");
+
+	return summary;
+}
@@ -0,0 +1,70 @@
+/*
+* synth.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <string>
+#include <vector>
+
+/**
+* Describes the synthetic Delphi file that's generated.
+**/
+struct SynthOptions
+{
+	/// Number of generated classes (in addition to the VCL classes the forms use).
+	unsigned int classes;
+
+	/// Length of the inheritance chains of the generated classes.
+	unsigned int depth;
+
+	/// Published properties, methods and fields of each generated class.
+	unsigned int properties;
+	unsigned int methods;
+	unsigned int fields;
+
+	/// Number of forms (RCDATA resources) and components per form.
+	unsigned int forms;
+	unsigned int components;
+
+	/// Depth of panels within panels on the forms.
+	unsigned int nesting;
+
+	/// Kinds of DFM data that are used on the forms.
+	bool collections;
+	bool lists;
+	bool bitmaps;
+
+	/// Seed of the generator. The same options always produce the same file.
+	unsigned int seed;
+
+	SynthOptions() : classes(100), depth(4), properties(4), methods(4), fields(2), forms(4), components(20),
+		nesting(2), collections(true), lists(true), bitmaps(true), seed(1) {}
+};
+
+/**
+* Describes what was generated.
+**/
+struct SynthSummary
+{
+	unsigned int vmts;
+	unsigned int properties;
+	unsigned int methods;
+	unsigned int fields;
+	unsigned int forms;
+	unsigned int components;
+
+	SynthSummary() : vmts(0), properties(0), methods(0), fields(0), forms(0), components(0) {}
+};
+
+SynthSummary generateDelphiFile(const SynthOptions& options, std::vector<unsigned char>& image);
+SynthSummary writeDelphiFile(const std::string& filename, const SynthOptions& options);
+
+#endif
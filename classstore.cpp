@@ -0,0 +1,90 @@
+/*
+* classstore.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "classstore.h"
+#include "trace.h"
+
+#include <deque>
+
+/**
+* Creates the compact form of a VMT tree and moves the members of all
+* classes into it. Classes that were read lazily are read first.
+* @param vmtdir The VMT tree.
+**/
+ClassStore::ClassStore(VMTDir& vmtdir)
+{
+	TraceSpan span("class store");
+	
+	materializeExtraInfo(vmtdir);
+	
+	// The memoized property types refer to members that leave the tree.
+	clearAttributeTypes(vmtdir);
+	
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	unsigned int propertyTotal = 0;
+	unsigned int methodTotal = 0;
+	unsigned int fieldTotal = 0;
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		propertyTotal += static_cast<unsigned int>(vmts[i]->typeinfo.size());
+		methodTotal += static_cast<unsigned int>(vmts[i]->methods.size());
+		fieldTotal += static_cast<unsigned int>(vmts[i]->fields.size());
+	}
+	
+	roots = static_cast<unsigned int>(vmtdir.size());
+	records.resize(vmts.size());
+	properties.reserve(propertyTotal);
+	methods.reserve(methodTotal);
+	fields.reserve(fieldTotal);
+	
+	// fill appends the children of each class in one go, so the children
+	// of a class get consecutive indices.
+	unsigned int nextChild = roots;
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		VMT* vmt = vmts[i];
+		ClassRecord& record = records[i];
+		
+		record.offset = vmt->offset;
+		record.nameoffset = vmt->nameoffset;
+		record.name = vmt->name;
+		record.vmtTypeInfo = vmt->vmtTypeInfo;
+		
+		record.firstChild = nextChild;
+		record.childCount = static_cast<unsigned int>(vmt->children.size());
+		
+		for (unsigned int j=0;j<record.childCount;++j)
+		{
+			records[nextChild++].parent = i;
+		}
+		
+		record.firstProperty = static_cast<unsigned int>(properties.size());
+		record.propertyCount = static_cast<unsigned int>(vmt->typeinfo.size());
+		properties.insert(properties.end(), vmt->typeinfo.begin(), vmt->typeinfo.end());
+		
+		record.firstMethod = static_cast<unsigned int>(methods.size());
+		record.methodCount = static_cast<unsigned int>(vmt->methods.size());
+		methods.insert(methods.end(), vmt->methods.begin(), vmt->methods.end());
+		
+		record.firstField = static_cast<unsigned int>(fields.size());
+		record.fieldCount = static_cast<unsigned int>(vmt->fields.size());
+		fields.insert(fields.end(), vmt->fields.begin(), vmt->fields.end());
+		
+		// The store replaces the member lists of the tree. Swapping with
+		// empty lists also frees their memory.
+		std::vector<PropInfo>().swap(vmt->typeinfo);
+		std::vector<MethodInfo>().swap(vmt->methods);
+		std::vector<FieldInfo>().swap(vmt->fields);
+	}
+}
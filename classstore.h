@@ -0,0 +1,89 @@
+/*
+* classstore.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef CLASSSTORE_H
+#define CLASSSTORE_H
+
+#include "VMTDir.h"
+
+#include <vector>
+
+/**
+* The parts of a VMT that are still needed once the VMT tree was read and
+* synchronized. Related classes and members are referenced by their
+* indices in the ClassStore.
+**/
+struct ClassRecord
+{
+	unsigned int offset;
+	unsigned int nameoffset;
+	std::string* name;
+	unsigned int vmtTypeInfo;
+	
+	/**
+	* Index of the parent class (ClassStore::NO_CLASS for top-level classes).
+	**/
+	unsigned int parent;
+	
+	/**
+	* The children of a class are stored next to each other.
+	**/
+	unsigned int firstChild;
+	unsigned int childCount;
+	
+	unsigned int firstProperty;
+	unsigned int propertyCount;
+	unsigned int firstMethod;
+	unsigned int methodCount;
+	unsigned int firstField;
+	unsigned int fieldCount;
+	
+	ClassRecord()
+	{
+		name = 0;
+		parent = 0xFFFFFFFF;
+	}
+};
+
+/**
+* A compact form of a VMT tree. All classes are stored in one array in the
+* order of fill (top-level classes first, every class before its children)
+* and the members of all classes are stored in shared arrays. Names are
+* shared with the VMT tree, so renaming a class renames it in both.
+*
+* The members are moved out of the VMT tree: once the store exists the
+* VMTs have no properties, methods or fields anymore, so the tree can't be
+* searched for members (synchronize, checkStringCollisions) afterwards.
+* Passes over all classes (obfuscating, writing, printing) use the store
+* instead of following the pointers of the tree. The member names must be
+* freed with the tree (see release).
+**/
+struct ClassStore
+{
+	static const unsigned int NO_CLASS = 0xFFFFFFFF;
+	
+	/**
+	* The first roots records are the top-level classes.
+	**/
+	unsigned int roots;
+	
+	std::vector<ClassRecord> records;
+	std::vector<PropInfo> properties;
+	std::vector<MethodInfo> methods;
+	std::vector<FieldInfo> fields;
+	
+	explicit ClassStore(VMTDir& vmtdir);
+	
+	private:
+		ClassStore(const ClassStore&);
+		ClassStore& operator=(const ClassStore&);
+};
+
+#endif
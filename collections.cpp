@@ -0,0 +1,90 @@
+/*
+* collections.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "collections.h"
+
+#include <fstream>
+
+/**
+* The collections of the VCL and of some well-known component packs.
+**/
+const char* knownCollections[][2] = {
+	{ "TdfsStatusPanels", "TdfsStatusPanel" },
+	{ "TCoolBands", "TCoolBand" },
+	{ "TStatusPanels", "TStatusPanel" },
+	{ "THeaderSections", "THeaderSection" },
+	{ "TListColumns", "TListColumn" },
+	{ "TmxStatusPanels", "TmxStatusPanel" },
+	{ "TActionBars", "TActionBarItem" },
+	{ "TActionClients", "TActionClientItem" },
+	{ "TDBGridColumns", "TDBGridColumns" },
+	{ "TDBGridColumnsEh", "TDBGridColumnsEh" },
+	{ "TAggregates", "TAggregates" },
+	{ "TDBSumCollection", "TDBSumCollection" },
+	{ "TParameters", "TParameter" }
+};
+
+/**
+* Returns a table of the built-in collections.
+**/
+CollectionTable createCollectionTable()
+{
+	CollectionTable table;
+	
+	for (unsigned int i=0;i<sizeof(knownCollections) / sizeof(knownCollections[0]);++i)
+	{
+		table[knownCollections[i][0]] = knownCollections[i][1];
+	}
+	
+	return table;
+}
+
+/// Used by threads that don't run a PythiaContext.
+const CollectionTable knownCollectionTable = createCollectionTable();
+
+PYTHIA_THREAD_LOCAL const CollectionTable* collectionTable = 0;
+
+/**
+* Reads a file with additional collections (e.g. of in-house components).
+* Each line contains the name of a collection class followed by the name
+* of its item class. Entries of the file replace entries of the table.
+* @param filename Name of the file.
+* @param table The collections are added to this table.
+**/
+void readCollectionFile(const std::string& filename, CollectionTable& table)
+{
+	std::ifstream file(filename.c_str());
+	
+	if (!file) throw std::string("Error: Couldn't open collection file " + filename + ".");
+	
+	std::string collection;
+	std::string item;
+	
+	while (file >> collection >> item)
+	{
+		table[collection] = item;
+	}
+	
+	if (!file.eof()) throw std::string("Error: Couldn't read collection file " + filename + ".");
+}
+
+/**
+* Returns the name of the item class of a collection.
+* @param collection Name of the collection class.
+* @return The name of the item class or 0 if the collection is unknown.
+**/
+const std::string* collectionItemName(const std::string& collection)
+{
+	const CollectionTable& table = collectionTable ? *collectionTable : knownCollectionTable;
+	
+	CollectionTable::const_iterator Iter = table.find(collection);
+	
+	return Iter != table.end() ? &Iter->second : 0;
+}
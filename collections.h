@@ -0,0 +1,32 @@
+/*
+* collections.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef COLLECTIONS_H
+#define COLLECTIONS_H
+
+#include "threads.h"
+
+#include <map>
+#include <string>
+
+/**
+* Maps the names of collection classes to the names of their item classes.
+**/
+typedef std::map<std::string, std::string> CollectionTable;
+
+/// The collections that are used on the thread (0 for the built-in ones).
+/// It's set by the PythiaContext that runs on the thread.
+extern PYTHIA_THREAD_LOCAL const CollectionTable* collectionTable;
+
+CollectionTable createCollectionTable();
+void readCollectionFile(const std::string& filename, CollectionTable& table);
+const std::string* collectionItemName(const std::string& collection);
+
+#endif
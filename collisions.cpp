@@ -1,55 +1,117 @@
+/*
+* collisions.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 - 2007 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
 #include "collisions.h"
 #include "helpers.h"
-#include "sync.h"
+#include "strkernels.h"
+#include "stats.h"
+#include "write.h"
 
 /**
-* Creates a new ComponentFinder object.
-*
-* @param searchString String to search for.
+* Creates an empty name set.
 **/
-ComponentFinder::ComponentFinder(const std::string& searchString)
-	: searchString(searchString), foundString(false)
+NameSet::NameSet() : slots(64), count(0)
 {
 }
 
 /**
-* Updates the states of the object if the resource was found.
+* Doubles the size of the hash table.
 **/
-void ComponentFinder::resourceCallback(DFMResource* res)
+void NameSet::grow()
 {
-	if (*res->name == searchString)
+	std::vector<const std::string*> old(slots.size() * 2);
+	old.swap(slots);
+	count = 0;
+
+	for (unsigned int i=0;i<old.size();++i)
 	{
-		foundString = true;
-		res = res;
+		if (old[i]) insert(old[i]);
 	}
 }
 
 /**
-* Unused
+* Adds a name to the set. Names that are already in the set are ignored.
+*
+* @param name The name to add.
 **/
-void ComponentFinder::propertyCallback(DFMProperty& property)
+void NameSet::insert(const std::string* name)
 {
+	if (!name || name->empty()) return;
+
+	// Keep the table at most half full so that the probe sequences stay short.
+	if ((count + 1) * 2 > slots.size()) grow();
+
+	size_t mask = slots.size() - 1;
+
+	for (size_t i = static_cast<size_t>(hashIgnoreCase(*name)) & mask;;i = (i + 1) & mask)
+	{
+		if (!slots[i])
+		{
+			slots[i] = name;
+			++count;
+			return;
+		}
+
+		if (equalsIgnoreCase(*slots[i], *name)) return;
+	}
 }
 
 /**
-* Returns a flag that indicates whether the search was succesful or not.
+* Indicates whether a name is in the set.
 *
-* @return A flag that indicates whether the search was succesful or not.
+* @param name The name to search for.
+* @return True if the name is in the set.
 **/
-bool ComponentFinder::found() const { return foundString; }
+bool NameSet::contains(const std::string& name) const
+{
+	size_t mask = slots.size() - 1;
+
+	for (size_t i = static_cast<size_t>(hashIgnoreCase(name)) & mask;slots[i];i = (i + 1) & mask)
+	{
+		if (equalsIgnoreCase(*slots[i], name)) return true;
+	}
+
+	return false;
+}
 
 /**
-* Returns the located resource if the search was succesful.
+* Finds the VCL type of a (possibly nested) property.
 *
-* @return The located resource or 0.
+* @param vmt The class the property belongs to.
+* @param name The segments of the property name (e.g. Font and Name).
+* @param vmtdir A VMT directory.
+* @return The name of the type or 0 if the type couldn't be found.
 **/
-const DFMResource* ComponentFinder::foundResource() const { return res; }
+const std::string* findType(const VMT* vmt, const std::vector<std::string*>& name, const VMTDir& vmtdir)
+{
+	const std::string* type = 0;
+
+	for (unsigned int i=0;i<name.size();++i)
+	{
+		if (!vmt) return 0;
+
+		type = getAttributeType(vmt, *name[i], vmtdir);
+
+		if (!type) return 0;
+
+		if (i + 1 < name.size()) vmt = handleCollections(find<FindByName>(vmtdir, *type), vmtdir);
+	}
+
+	return type;
+}
 
 /**
 * Creates a new CollisionVisitor object.
 **/
-CollisionVisitor::CollisionVisitor(DFMData& dfmData, const VMTDir& vmtDir)
-	: dfmData(dfmData), vmtDir(vmtDir), lastResource(0)
+CollisionVisitor::CollisionVisitor(const VMTDir& vmtDir, const NameSet& names)
+	: vmtDir(vmtDir), names(names), lastResource(0), lastClass(0), collisionCount(0)
 {
 }
 
@@ -57,98 +119,158 @@ void CollisionVisitor::resourceCallback(DFMResource* res)
 {
 	// Keep track of what resource is currently traversed.
 	lastResource = res;
+	lastClass = handleCollections(find<FindByName>(vmtDir, *res->classname), vmtDir);
 }
 
 void CollisionVisitor::propertyCallback(DFMProperty& property)
 {
-	// At this point we're trying to find the property values which also
-	// appear as component names. These values are necessarily Strings.
-	// The type of these values is not limited to DFM_STRING though.
+	checkProperty(lastClass, property);
+}
 
-	extern bool verboseMode;
+/**
+* Checks a property and the properties of its collection items.
+*
+* @param vmt The class the property belongs to.
+* @param property The property.
+**/
+void CollisionVisitor::checkProperty(const VMT* vmt, DFMProperty& property)
+{
+	if (!vmt || property.name.empty()) return;
 
-	if (property.value.size() == 0)
+	// Items of collections are instances of the collection's item class.
+	if (property.values.size())
 	{
-		// If there's no value, then the value can't possible be the name
-		// of a component.
-		return;
+		const std::string* type = findType(vmt, property.name, vmtDir);
+		const VMT* itemClass = type ? handleCollections(find<FindByName>(vmtDir, *type), vmtDir) : 0;
+
+		for (unsigned int i=0;i<property.values.size();++i)
+		{
+			checkProperty(itemClass, property.values[i]);
+		}
 	}
 
-	VERBOSE_PRINT("Collision check: " << concatStringVector(property.value) 
-			<< " in resource " << *lastResource->classname << " " << *lastResource->name);
+	// At this point we're trying to find the property values which also
+	// appear as names that are obfuscated. These values are necessarily
+	// Strings. The type of these values is not limited to DFM_STRING though.
 
 	if (property.type != DFM_ENUM
 		&& property.type != DFM_STRING
 		&& property.type != DFM_LONGSTRING
 		&& property.type != DFM_LONGSTRING2)
 	{
-		// If it's none of those types, the value can't possibly be the name
-		// of a component.
+		// If it's none of those types, the value can't possibly be a name.
 		return;
 	}
 
-	// Create a deep copy of the property name vector.
-	std::vector<std::string*> value = deepCopy(property.name);
+	// The value was split at its periods during synchronization. If any
+	// part of it is an obfuscated name it would be changed together with
+	// that name.
+	bool collision = false;
 
-	// Find the VCL type of the property.
-	const std::string* type = findType(*lastResource->classname, value, vmtDir, dfmData);
+	for (unsigned int i=0;i<property.value.size() && !collision;++i)
+	{
+		collision = names.contains(*property.value[i]);
+	}
 
-	if (!type)
+	if (!collision)
 	{
-		std::cout << "Error: Can't find type of property " << *value[0] << std::endl;
+		// We're in the clear here. No conflict exists for that property.
 		return;
 	}
 
-	VERBOSE_PRINT("Type found: " << *type);
+	// Find the VCL type of the property.
+	const std::string* type = findType(vmt, property.name, vmtDir);
 
-	if (
-		*type != "String" &&
-		*type != "WideString" &&
-		*type != "TCaption" &&
-		*type != "TFontName"
-	)
+	if (!type)
 	{
-		// TODO: Add TFontName?
-
-		// Only these VCL types can cause conflicts.
+		VERBOSE_PRINT("Can't find type of property " << joinName(property.name) << " in resource "
+			<< *lastResource->classname << " " << *lastResource->name);
 		return;
 	}
-	
-	// At this point we have the value of a String property. Now
-	// we need to check if a component with this name exists.
-	// TODO: Method names, Property Names, Field Names, ...
 
-	// TODO: value[0] should be value[all] ?
-	ComponentFinder finder(*property.value[0]);
-	finder.visit(dfmData);
-
-	if (!finder.found())
+	if (
+		!equalsIgnoreCase(*type, "String") &&
+		!equalsIgnoreCase(*type, "WideString") &&
+		!equalsIgnoreCase(*type, "AnsiString") &&
+		!equalsIgnoreCase(*type, "UnicodeString") &&
+		!equalsIgnoreCase(*type, "TCaption") &&
+		!equalsIgnoreCase(*type, "TTranslateString") &&
+		!equalsIgnoreCase(*type, "TFontName")
+	)
 	{
-		// We're in the clear here. No conflict exists for that property.
+		// Only these VCL types can cause conflicts. Values of other types
+		// (component references, event handlers) really are names.
 		return;
 	}
 
 	// A conflict exists. Mark this property value as "Do not obfuscate"
 	property.obfuscateValue = false;
+	++collisionCount;
+
+	VERBOSE_PRINT("String conflict: " << joinName(property.name) << " has value \"" << joinName(property.value)
+		<< "\" in resource " << *lastResource->classname << " " << *lastResource->name << ". A symbol has the same name.");
+}
+
+/**
+* Adds the names of a resource and its children to a name set.
+**/
+void collectNames(const DFMResource* res, NameSet& names)
+{
+	names.insert(res->name);
 
-	VERBOSE_PRINT("String conflict: " << concatStringVector(property.name) << " has value \"" << *property.value[0] << "\". A component has the same name.");
+	for (unsigned int i=0;i<res->children.size();++i)
+	{
+		collectNames(res->children[i], names);
+	}
 }
 
 /**
-* String properties that have the same value as the name of a component should
-* not be obfuscated. It's assumed that the value of the string is a coincidence
-* and does not reference the component's name.
+* String properties that have the same value as the name of a component,
+* class, method, property or field should not be obfuscated. It's assumed
+* that the value of the string is a coincidence and does not reference the
+* name (Delphi uses the name of a new button as its caption, for example).
 *
 * This function searches for these situations and marks the found string values
-* with a flag that says that the values should not be obfuscated.
+* with a flag that says that the values should not be obfuscated. All names
+* are collected into a hash set first so each property is checked with a
+* single lookup.
+*
+* It must be called after synchronize and before obfuscate.
 *
 * @param dfmres A DFM Resource.
-* @param VMTDir A VMT directory.
+* @param vmtdir A VMT directory.
+* @return The number of property values that must not be obfuscated.
 **/
-void checkStringCollisions(DFMData& dfmres, const VMTDir& vmtdir)
+unsigned int checkStringCollisions(DFMData& dfmres, const VMTDir& vmtdir)
 {
-	// TODO: Don't just check component names but property names, method
-	// names and field names too.
-	CollisionVisitor(dfmres, vmtdir).visit(dfmres);
-}
+	PhaseTimer timer(PHASE_COLLISIONS);
+
+	NameSet names;
+
+	for (unsigned int i=0;i<dfmres.size();++i)
+	{
+		collectNames(dfmres[i], names);
+	}
 
+	// Every member of every class is a name that's obfuscated.
+	materializeExtraInfo(vmtdir);
+
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		names.insert(vmts[i]->name);
+
+		for (unsigned int j=0;j<vmts[i]->typeinfo.size();++j) names.insert(vmts[i]->typeinfo[j].name);
+		for (unsigned int j=0;j<vmts[i]->methods.size();++j) names.insert(vmts[i]->methods[j].name);
+		for (unsigned int j=0;j<vmts[i]->fields.size();++j) names.insert(vmts[i]->fields[j].name);
+	}
+
+	CollisionVisitor visitor(vmtdir, names);
+	visitor.visit(dfmres);
+
+	addCounter(COUNTER_COLLISIONS, visitor.collisions());
+
+	return visitor.collisions();
+}
@@ -14,57 +14,48 @@
 #include "VMTDir.h"
 #include "DFMParser.h"
 
-void checkStringCollisions(DFMData& dfmres, const VMTDir& vmtdir);
+#include <string>
+#include <vector>
 
-// TODO: Add some way to stop traversal of directories.
+unsigned int checkStringCollisions(DFMData& dfmres, const VMTDir& vmtdir);
+const std::string* findType(const VMT* vmt, const std::vector<std::string*>& name, const VMTDir& vmtdir);
 
 /**
-* This class is used to search for components with a given name.
+* A hashed set of names. Names are compared without regard to their case.
+* The set doesn't own the strings, they must live as long as the set.
 **/
-class ComponentFinder : public DFMVisitor
+class NameSet
 {
 	private:
 		/**
-		* The name of the component to search.
+		* Open addressing hash table (the size is a power of 2).
 		**/
-		std::string searchString;
+		std::vector<const std::string*> slots;
 
 		/**
-		* Flag that indicates whether the search was successful.
+		* Number of names in the set.
 		**/
-		bool foundString;
+		size_t count;
 
-		/**
-		* The found resource (or 0).
-		**/
-		const DFMResource* res;
-
-	protected:
-		/**
-		* Called for each DFMResource in the DFM directory.
-		**/
-		virtual void resourceCallback(DFMResource* res);
-
-		/**
-		* Called for each DFMProperty in the DFM directory;
-		**/
-		virtual void propertyCallback(DFMProperty& property);
+		void grow();
 
 	public:
+		NameSet();
+
 		/**
-		* Creates a new ComponentFinder object.
+		* Adds a name to the set.
 		**/
-		ComponentFinder(const std::string& searchString);
+		void insert(const std::string* name);
 
 		/**
-		* Flag that indicates whether the search was succesful.
+		* Indicates whether a name is in the set.
 		**/
-		bool found() const;
+		bool contains(const std::string& name) const;
 
 		/**
-		* Found resource or 0.
+		* Number of names in the set.
 		**/
-		const DFMResource* foundResource() const;
+		size_t size() const { return count; }
 };
 
 /**
@@ -75,20 +66,32 @@ class CollisionVisitor : public DFMVisitor
 {
 	private:
 		/**
-		* The DFM directory to traverse.
+		* The VMT Directory that's synchronized with the DFMDirectory.
 		**/
-		DFMData& dfmData;
+		const VMTDir& vmtDir;
 
 		/**
-		* The VMT Directory that's synchronized with the DFMDirectory.
+		* All names that are obfuscated.
 		**/
-		const VMTDir& vmtDir;
+		const NameSet& names;
 
 		/**
 		* The last traversed resource.
 		**/
 		const DFMResource* lastResource;
 
+		/**
+		* The class of the last traversed resource (or 0).
+		**/
+		const VMT* lastClass;
+
+		/**
+		* Number of property values that must not be obfuscated.
+		**/
+		unsigned int collisionCount;
+
+		void checkProperty(const VMT* vmt, DFMProperty& property);
+
 	protected:
 		/**
 		* Called for each DFMResource in the DFM directory.
@@ -105,10 +108,15 @@ class CollisionVisitor : public DFMVisitor
 		/**
 		* Creates a new CollisionVisitor object.
 		*
-		* @param dfmData A DFM directory.
 		* @param vmtDir A VMT directory.
+		* @param names All names that are obfuscated.
+		**/
+		CollisionVisitor(const VMTDir& vmtDir, const NameSet& names);
+
+		/**
+		* Number of property values that must not be obfuscated.
 		**/
-		CollisionVisitor(DFMData& dfmData, const VMTDir& vmtDir);
+		unsigned int collisions() const { return collisionCount; }
 };
 
 #endif
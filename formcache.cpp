@@ -0,0 +1,98 @@
+/*
+* formcache.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "formcache.h"
+#include "hash.h"
+#include "mapfile.h"
+#include "modelcache.h"
+#include "serialize.h"
+
+#include <iomanip>
+#include <sstream>
+
+/**
+* The same forms (About dialogs, Login dialogs, ...) appear byte-identical in
+* many files. The parsed structure of each form is stored in a cache directory
+* under the hash of the form data. All offsets are stored relative to the
+* beginning of the form data so the structure can be reused in files where
+* the form is located at a different offset.
+**/
+const unsigned int FORM_MAGIC = 0x43465950; // "PYFC"
+
+/// Must be incremented whenever the layout of the cache files changes.
+const unsigned int FORM_VERSION = 1;
+
+/// Seed of the second hash that guards against collisions of the first hash.
+const unsigned long long FORM_SEED = 0x5059544849414643ULL;
+
+/**
+* Returns the name of the cache file of a form.
+**/
+std::string cachedFormName(const std::string& directory, const unsigned char* data, unsigned int size)
+{
+	std::stringstream ss;
+	ss << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hashBytes(data, size) << ".dfm";
+	return ss.str();
+}
+
+/**
+* Loads the parsed structure of a form from the cache.
+* @param directory The cache directory.
+* @param data The form data (after the 'TPF0' signature).
+* @param size Size of the form data.
+* @param offset File offset of the form data.
+* @return The form or 0 if the form is not in the cache.
+**/
+DFMResource* loadCachedForm(const std::string& directory, const unsigned char* data, unsigned int size, unsigned int offset)
+{
+	MappedFile file;
+	
+	if (!file.open(cachedFormName(directory, data, size)) || file.size() < 8) return 0;
+	
+	// The last 8 bytes are the hash of everything before.
+	BinaryReader trailer(file.data() + file.size() - 8, 8);
+	if (trailer.u64() != hashBytes(file.data(), file.size() - 8)) return 0;
+	
+	BinaryReader reader(file.data(), file.size() - 8);
+	
+	try
+	{
+		if (reader.u32() != FORM_MAGIC || reader.u32() != FORM_VERSION) return 0;
+		if (reader.u32() != size || reader.u64() != hashBytes(data, size, FORM_SEED)) return 0;
+		
+		return readResource(reader, 0, offset);
+	}
+	catch(const std::string&)
+	{
+		return 0;
+	}
+}
+
+/**
+* Stores the parsed structure of a form in the cache.
+* @param directory The cache directory.
+* @param data The form data (after the 'TPF0' signature).
+* @param size Size of the form data.
+* @param offset File offset of the form data.
+* @param dfm The parsed form.
+* @return True if the form was stored.
+**/
+bool saveCachedForm(const std::string& directory, const unsigned char* data, unsigned int size, unsigned int offset, const DFMResource* dfm)
+{
+	BinaryWriter writer;
+	writer.u32(FORM_MAGIC);
+	writer.u32(FORM_VERSION);
+	writer.u32(size);
+	writer.u64(hashBytes(data, size, FORM_SEED));
+	writeResource(writer, dfm, offset);
+	writer.u64(hashBytes(&writer.buffer()[0], writer.size()));
+	
+	return writer.save(cachedFormName(directory, data, size));
+}
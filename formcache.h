@@ -0,0 +1,21 @@
+/*
+* formcache.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef FORMCACHE_H
+#define FORMCACHE_H
+
+#include "DFMParser.h"
+
+#include <string>
+
+DFMResource* loadCachedForm(const std::string& directory, const unsigned char* data, unsigned int size, unsigned int offset);
+bool saveCachedForm(const std::string& directory, const unsigned char* data, unsigned int size, unsigned int offset, const DFMResource* dfm);
+
+#endif
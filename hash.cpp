@@ -0,0 +1,78 @@
+/*
+* hash.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "hash.h"
+#include "mapfile.h"
+
+#include <cstring>
+
+/**
+* Final mixing step of the hash (taken from MurmurHash3).
+**/
+unsigned long long mix(unsigned long long h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+* Calculates a fast 64-bit hash of a block of data. The data is processed
+* eight bytes at a time. The hash is not cryptographically secure.
+* @param data The data.
+* @param size Size of the data.
+* @param seed Different seeds produce unrelated hashes of the same data.
+* @return The hash of the data.
+**/
+unsigned long long hashBytes(const unsigned char* data, size_t size, unsigned long long seed)
+{
+	const unsigned long long multiplier = 0x9E3779B97F4A7C15ULL;
+	
+	unsigned long long h = seed ^ (static_cast<unsigned long long>(size) * multiplier);
+	
+	size_t blocks = size / 8;
+	
+	for (size_t i=0;i<blocks;++i)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i * 8, 8);
+		
+		h = (h ^ mix(word)) * multiplier;
+	}
+	
+	unsigned long long tail = 0;
+	
+	for (size_t i=blocks * 8;i<size;++i)
+	{
+		tail = (tail << 8) | data[i];
+	}
+	
+	return mix(h ^ mix(tail ^ multiplier));
+}
+
+/**
+* Calculates the hash of the content of a file.
+* @param filename Name of the file.
+* @return The hash of the file.
+**/
+unsigned long long hashFile(const std::string& filename)
+{
+	MappedFile file;
+	
+	if (!file.open(filename))
+	{
+		throw std::string("Error: Couldn't open file " + filename + ".");
+	}
+	
+	return hashBytes(file.data(), file.size());
+}
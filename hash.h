@@ -0,0 +1,20 @@
+/*
+* hash.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <string>
+
+unsigned long long hashBytes(const unsigned char* data, size_t size, unsigned long long seed = 0);
+unsigned long long hashFile(const std::string& filename);
+
+#endif
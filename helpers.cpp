@@ -8,10 +8,13 @@
 * For more details see http://www.opensource.org/licenses/zlib-license.php
 */
 
+#include "threads.h"
+
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
-unsigned int g_recognizedVmts;
+PYTHIA_THREAD_LOCAL std::ostream* verboseLog = 0;
 
 /**
 * Prints an error message to stdout and terminates the program
@@ -16,12 +16,23 @@
 #include <set>
 #include <deque>
 #include <cctype>
+#include <iostream>
 
 #include "VMTDir.h"
+#include "stats.h"
+#include "strkernels.h"
+#include "threads.h"
 
 /// Prints an error message and terminates the program.
 void die(const std::string& error);
 
+/// Where details of the analysis are printed (0 if they're not printed).
+/// It's set by the PythiaContext that runs on the thread.
+extern PYTHIA_THREAD_LOCAL std::ostream* verboseLog;
+
+/// Prints a message if verbose output was requested (-v).
+#define VERBOSE_PRINT(x) do { if (verboseLog) *verboseLog << x << std::endl; } while (0)
+
 /**
 * Performs non-case sensitive string comparison.
 * @param s1 The first string.
@@ -112,54 +123,86 @@ std::string toHexString(T x)
 }
 
 /**
-* Produces a random letter or number.
+* Produces random letters and numbers. Every generator has its own state
+* (unlike rand()), so generators of parallel runs don't affect each other.
 **/
-struct RandomCharacterGenerator
+class RandomCharacterGenerator
 {
-	char operator()()
-	{
-		unsigned int randValue = rand() % 62;
-			
-		if (randValue <= 9) return '0' + randValue;
-		else if (randValue <=  35) return 'A' + randValue - 10;
-		else return 'a' + randValue - 36;
-	}
+	private:
+		unsigned int state_;
+		
+	public:
+		RandomCharacterGenerator(unsigned int seed) : state_(seed * 2654435761u + 1) {}
+		
+		/**
+		* Returns a random number from 0 to n - 1.
+		**/
+		unsigned int below(unsigned int n)
+		{
+			state_ = state_ * 1664525 + 1013904223;
+			return (state_ >> 8) % n;
+		}
+		
+		/**
+		* Returns a random upper-case letter.
+		**/
+		char letter()
+		{
+			return static_cast<char>('A' + below(26));
+		}
+		
+		/**
+		* Returns a random letter or number.
+		**/
+		char operator()()
+		{
+			unsigned int randValue = below(62);
+				
+			if (randValue <= 9) return '0' + randValue;
+			else if (randValue <=  35) return 'A' + randValue - 10;
+			else return 'a' + randValue - 36;
+		}
 };
 
 /**
 * Generates a random string of the given size. It's guaranteed that the first
 * character of the string is a letter.
-* @param maxsize Size of the string.
+* @param size Size of the string.
+* @param generator The generator of the characters.
 * @return A random string 
 **/
 template<typename T>
-std::string randomString(unsigned int size)
+std::string randomString(unsigned int size, T& generator)
 {
 	if (!size) return "";
 	
-	std::string ret(size, (char)('A' + rand() % 26));
+	std::string ret(size, generator.letter());
 	
-	std::generate(ret.begin() + 1, ret.end(), T());
+	for (unsigned int i=1;i<size;++i)
+	{
+		ret[i] = generator();
+	}
 	
 	return ret;
 }
 
 /**
 * Makes sure that all generated random strings are unique.
-* @param Size of the random string to generate.
+* @param size Size of the random string to generate.
+* @param strings All strings that are already in use. The generated string
+*        is added to this set.
+* @param generator The generator of the characters.
 * @return A random string of the given size.
 **/
 template<typename T>
-std::string uniqueString(unsigned int size)
+std::string uniqueString(unsigned int size, std::set<std::string>& strings, T& generator)
 {
 	if (size == 0) return "";
 	
-	static std::set<std::string> strings;
-	
 	// Make 20 attempts to generate a unique string.
 	for (unsigned int i=0;i<20;++i)
 	{
-		std::string retstr = randomString<T>(size);
+		std::string retstr = randomString(size, generator);
 
 		if (strings.find(retstr) == strings.end())
 		{
@@ -170,7 +213,6 @@ std::string uniqueString(unsigned int size)
 	
 	throw std::string("Error: Cannot create enough unique strings.");
 }
-#include <iostream>
 template<typename T>
 struct FindByName
 {
@@ -192,6 +234,8 @@ typename Container::value_type find(const Container& cont, const std::string& va
 {
 	typedef typename Container::value_type Element;
 	
+	addCounter(COUNTER_NAME_LOOKUPS);
+	
 	std::deque<Element> vals(cont.begin(), cont.end());
 
 	while (vals.size())
@@ -235,7 +279,7 @@ std::string* getValue(const T& vals, const std::string& val, bool ignoreCase = f
 	for (unsigned int i=0;i<vals.size();++i)
 	{
 		if (!ignoreCase && *vals[i].name == val) return vals[i].name;
-		else if (ignoreCase && cmpncs(*vals[i].name, val)) return vals[i].name;
+		else if (ignoreCase && equalsIgnoreCase(*vals[i].name, val)) return vals[i].name;
 	}
 	
 	return 0;
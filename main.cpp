@@ -8,12 +8,16 @@
 * For more details see http://www.opensource.org/licenses/zlib-license.php
 */
 
-#include "DFMParser.h"
-#include "VmtDir.h"
+#include "pythia.h"
 #include "helpers.h"
-#include "obfuscate.h"
-#include "write.h"
-#include "sync.h"
+#include "mapping.h"
+#include "patchfile.h"
+#include "batch.h"
+#include "threads.h"
+#include "stats.h"
+#include "trace.h"
+#include "print.h"
+#include "collections.h"
 
 #include <cstdlib>
 #include <iostream>
@@ -24,89 +28,100 @@
 #include <iomanip>
 #include <PeLib.h>
 
-extern unsigned int g_recognizedVmts;
-
 void printUsage()
 {
-	std::cout << "Usage: pythia.exe [options] file\n\n";
+	std::cout << "Usage: pythia.exe [options] file\n";
+	std::cout << "       pythia.exe -u patchfile [-o f|-a] [-m f] file\n";
+	std::cout << "       pythia.exe -b [-j n] [-r d] [-a] directory|filelist\n\n";
 	std::cout << "Options:\n";
 	std::cout << "  -i    Prints information about the file (does not modify the file)\n";
+	std::cout << "  --class c  With -i, prints only the class c and the classes derived from it\n";
 	std::cout << "  -c    Show changes (Prints the obfuscated strings)\n";
+	std::cout << "  -v    Verbose output (prints details of the analysis)\n";
+	std::cout << "  -m f  Reuses the names assigned by a previous run that were stored in the\n";
+	std::cout << "        mapping file f and updates f afterwards\n";
+	std::cout << "  -l    Lazy: reads the fields, methods and properties of a class only when\n";
+	std::cout << "        they are needed (runs that don't change the file only pay for the\n";
+	std::cout << "        classes they look at)\n";
+	std::cout << "  -k f  Caches the parsed VMT and DFM data in the file f. The cache is used\n";
+	std::cout << "        as long as the input file doesn't change\n";
+	std::cout << "  -r d  Caches the parsed structure of each form in the directory d. Forms\n";
+	std::cout << "        that are byte-identical in several files are only parsed once\n";
+	std::cout << "  -o f  Writes the obfuscated file to f instead of modifying the input file\n";
+	std::cout << "  -a    Replaces the input file atomically instead of modifying it in place\n";
+	std::cout << "        (an interrupted run never leaves a half-obfuscated file behind)\n";
+	std::cout << "  -e f  Writes the changes to the patch file f instead of changing the file\n";
+	std::cout << "  -u f  Applies the patch file f to a file that is identical to the file the\n";
+	std::cout << "        patch file was made from (no parsing necessary)\n";
+	std::cout << "  --collections f  Reads the item classes of additional collections from f\n";
+	std::cout << "        (one collection class and its item class per line)\n";
+	std::cout << "  --no-collision-check  Obfuscates string values that have the same text as\n";
+	std::cout << "        a component, class, method, property or field (by default they're\n";
+	std::cout << "        left alone, e.g. a button captioned with its own name)\n";
+	std::cout << "  -b    Batch mode (obfuscates all executables of a directory or all files\n";
+	std::cout << "        listed in a text file)\n";
+	std::cout << "  -j n  Number of files that are obfuscated in parallel in batch mode or\n";
+	std::cout << "        number of threads that read the classes of a single file\n";
+	std::cout << "  -t    Prints the time spent in each phase and other statistics\n";
+	std::cout << "        (also --stats; --stats-json f writes them to f as JSON)\n";
+	std::cout << "  --perf  Adds hardware performance counters (cycles, instructions, cache and\n";
+	std::cout << "        branch misses, page faults) of each phase to -t (Linux only)\n";
+	std::cout << "  --trace f  Writes a timeline of the run to f (Chrome trace event format,\n";
+	std::cout << "        can be opened with chrome://tracing or Perfetto)\n";
 }
 
-void printStats()
-{
-	std::cout << "Recognized VMTs: " << g_recognizedVmts << "\n\n";
-}
-
-void printVMT(const VMT* vmt, std::string pad = "")
-{
-     std::cout << pad << "Name: " << *vmt->name << "\n";
-     std::cout << pad << "Offset: 0x" << std::uppercase << std::hex << vmt->offset << "\n";
-     std::cout << pad << "Properties: " << std::dec << vmt->typeinfo.size() << "\n";
-     
-     for (unsigned int i=0;i<vmt->typeinfo.size();i++)
-     {
-         std::cout << pad << "  " << *vmt->typeinfo[i].type << " " << *vmt->typeinfo[i].name << "\n";
-         std::cout << pad << "    GetProc: " << std::hex << vmt->typeinfo[i].GetProc << "\n";
-         std::cout << pad << "    SetProc: " << std::hex << vmt->typeinfo[i].SetProc << "\n";
-         std::cout << pad << "    StoredProc: " << std::hex << vmt->typeinfo[i].StoredProc << "\n";
-     }
-     
-     std::cout << pad << "Methods: " << std::dec << vmt->methods.size() << "\n";
-     
-     for (unsigned int i=0;i<vmt->methods.size();i++)
-     {
-         std::cout << pad << "  Name: " << *vmt->methods[i].name << " ( 0x" << std::hex << vmt->methods[i].va << " )\n";
-     }
-     
-     std::cout << pad << "Fields: " << std::dec << vmt->fields.size() << "\n";
-     
-     for (unsigned int i=0;i<vmt->fields.size();i++)
-     {
-         std::cout << pad << "  Name: " << *vmt->fields[i].name << "\n";
-     }
-     
-     std::cout << "\n";
-     
-     for (unsigned int i=0;i<vmt->children.size();i++)
-         printVMT(vmt->children[i], pad + "  ");
-}
+bool printInformation = false;
+bool showChanges = false;
+bool verbose = false;
+bool checkCollisions = true;
+std::string mappingFile;
+std::string modelCacheFile;
+std::string formCacheDirectory;
+std::string outputFile;
+bool atomicOutput = false;
+std::string exportFile;
+std::string patchFile;
+bool printTimings = false;
+bool perfCounters = false;
+std::string statsFile;
+std::string traceFile;
+unsigned int jobs = 0;
+bool lazyReading = false;
+std::string collectionFile;
+std::string className;
 
-void printDfm(DFMResource* dfm, std::string pad = "")
+/**
+* Prints or writes the statistics and the trace that were requested on the
+* command line.
+* @param statistics The statistics of the run.
+**/
+void reportStatistics(const Statistics& statistics)
 {
-     std::cout << pad << *dfm->classname << " " << *dfm->name << "\n";
-     
-     std::cout << pad << "Properties: " << std::dec << dfm->properties.size() << "\n";
-     
-     for (unsigned int i=0;i<dfm->properties.size();i++)
-     {
-          for (unsigned int j=0;j<dfm->properties[i].name.size();j++)
-          {
-              std::cout << pad << "  " << *dfm->properties[i].name[j] << "\n";
-          }
-          
-//          for (unsigned int j=0;j<dfm->properties[i].value.size();j++)
-//          {
-//              std::cout << pad << "  " << *dfm->properties[i].value[j] << "\n";
-//          }
-     }
-     
-     std::cout << "\n";
-     
-     for (unsigned int i=0;i<dfm->children.size();i++)
-         printDfm(dfm->children[i], pad + "  ");
+	if (printTimings)
+	{
+		statistics.print(std::cout, false);
+	}
+	
+	if (!statsFile.empty())
+	{
+		std::ofstream file(statsFile.c_str());
+		
+		if (file) statistics.print(file, true);
+		else std::cout << "Warning: Couldn't write statistics file " << statsFile << "\n";
+	}
+	
+	if (!traceFile.empty() && !writeTrace(traceFile))
+	{
+		std::cout << "Warning: Couldn't write trace file " << traceFile << "\n";
+	}
 }
 
-bool printInformation = false;
-bool showChanges = false;
+bool batchMode = false;
 	
 int main(int argc, char *argv[])
 {
 	std::cout << "Pythia 1.1 - Author: Sebastian Porst (webmaster@the-interweb.com)\n\n";
 	
-	srand(static_cast<unsigned int>(time(0)));
-	
 	if (argc < 2)
 	{
 		printUsage();
@@ -118,74 +133,257 @@ int main(int argc, char *argv[])
         if (!strcmp(argv[i], "-i"))
            printInformation = true;
            
+        if (!strcmp(argv[i], "--class") && i + 1 < argc - 1)
+           className = argv[++i];
+           
         if (!strcmp(argv[i], "-c"))
            showChanges = true;
+           
+        if (!strcmp(argv[i], "-v"))
+           verbose = true;
+           
+        if (!strcmp(argv[i], "--collections") && i + 1 < argc - 1)
+           collectionFile = argv[++i];
+           
+        if (!strcmp(argv[i], "--no-collision-check"))
+           checkCollisions = false;
+           
+        if (!strcmp(argv[i], "-l"))
+           lazyReading = true;
+           
+        if (!strcmp(argv[i], "-m") && i + 1 < argc - 1)
+           mappingFile = argv[++i];
+           
+        if (!strcmp(argv[i], "-k") && i + 1 < argc - 1)
+           modelCacheFile = argv[++i];
+           
+        if (!strcmp(argv[i], "-r") && i + 1 < argc - 1)
+           formCacheDirectory = argv[++i];
+           
+        if (!strcmp(argv[i], "-o") && i + 1 < argc - 1)
+           outputFile = argv[++i];
+           
+        if (!strcmp(argv[i], "-a"))
+           atomicOutput = true;
+           
+        if (!strcmp(argv[i], "-e") && i + 1 < argc - 1)
+           exportFile = argv[++i];
+           
+        if (!strcmp(argv[i], "-u") && i + 1 < argc - 1)
+           patchFile = argv[++i];
+           
+        if (!strcmp(argv[i], "-b"))
+           batchMode = true;
+           
+        if (!strcmp(argv[i], "-j") && i + 1 < argc - 1)
+           jobs = atoi(argv[++i]);
+           
+        if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--stats"))
+           printTimings = true;
+           
+        if (!strcmp(argv[i], "--stats-json") && i + 1 < argc - 1)
+           statsFile = argv[++i];
+           
+        if (!strcmp(argv[i], "--perf"))
+           perfCounters = true;
+           
+        if (!strcmp(argv[i], "--trace") && i + 1 < argc - 1)
+           traceFile = argv[++i];
+    }
+    
+    Statistics statistics;
+    StatisticsScope statisticsScope(statistics);
+    
+    if ( !traceFile.empty() )
+    {
+         startTracing();
+    }
+    
+    CollectionTable collections = createCollectionTable();
+    
+    if ( !collectionFile.empty() )
+    {
+         try
+         {
+              readCollectionFile(collectionFile, collections);
+         }
+         catch(const std::string& e)
+         {
+              die(e);
+         }
+    }
+    
+    if ( perfCounters )
+    {
+         if ( !startPerfCounters() )
+         {
+              std::cout << "Warning: Hardware performance counters are not available.\n\n";
+         }
+         
+         printTimings = printTimings || statsFile.empty();
     }
     
     if ( printInformation && showChanges )
     {
          die("-i and -c are mutually exclusive");
     }
+    
+    if ( !className.empty() && !printInformation )
+    {
+         die("--class can only be used together with -i");
+    }
+    
+    if ( batchMode )
+    {
+         if ( printInformation || showChanges || lazyReading || !mappingFile.empty() || !modelCacheFile.empty() || !outputFile.empty()
+              || !exportFile.empty() || !patchFile.empty() )
+         {
+              die("-b can't be combined with -i, -c, -l, -m, -k, -o, -e or -u");
+         }
+         
+         std::vector<std::string> files;
+         
+         try
+         {
+              collectBatchFiles(argv[argc - 1], files);
+         }
+         catch(const std::string& e)
+         {
+              die(e);
+         }
+         
+         BatchOptions options;
+         options.jobs = jobs ? jobs : hardwareThreads();
+         options.formCacheDirectory = formCacheDirectory;
+         options.atomicOutput = atomicOutput;
+         options.checkCollisions = checkCollisions;
+         options.seed = static_cast<unsigned int>(time(0));
+         options.collections = collections;
+         options.statistics = &statistics;
+         
+         unsigned int failed = processBatch(files, options);
+         
+         std::cout << "\n" << files.size() - failed << " of " << files.size() << " files were obfuscated.\n\n";
+         
+         reportStatistics(statistics);
+         
+         return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 	
     std::string filename = argv[argc - 1];
+    std::string output = !outputFile.empty() ? outputFile : atomicOutput ? filename : "";
+    
+    if ( !patchFile.empty() )
+    {
+         try
+         {
+              NameMapping mapping;
+              
+              PatchSummary summary = applyPatchFile(patchFile, filename, output, mapping);
+              
+              std::cout << "Changed " << summary.bytes << " bytes in " << summary.patches << " patches\n\n";
+              
+              if (!mappingFile.empty())
+              {
+                   writeMapping(mappingFile, mapping);
+              }
+         }
+         catch(const std::string& e)
+         {
+              die(e);
+         }
+         
+         reportStatistics(statistics);
+         
+         std::cout << "Everything seems to have worked. Try to start the obfuscated file now." << std::endl;
+         
+         return EXIT_SUCCESS;
+    }
     
-    PeLib::PeFile32 pefile(filename);
+    PythiaOptions options;
+    options.showChanges = showChanges;
+    options.verbose = verbose;
+    options.checkCollisions = checkCollisions;
+    options.lazy = lazyReading;
+    options.threads = jobs;
+    options.seed = static_cast<unsigned int>(time(0));
+    options.formCacheDirectory = formCacheDirectory;
+    options.modelCacheFile = modelCacheFile;
+    options.collections = collections;
+    options.statistics = &statistics;
     
-    if (pefile.readMzHeader() == 0 && pefile.readPeHeader() == 0 && pefile.readResourceDirectory() == 0)
+    try
     {
-	    VMTDir vmtdir;
-		
-		readVMTs(pefile, vmtdir);
-		
-		printStats();
-		
-		if ( printInformation )
-		{
-			for (std::vector<VMT*>::iterator Iter = vmtdir.begin(); Iter != vmtdir.end(); ++Iter)
-			{
-				printVMT(*Iter);
-			}
-//             std::for_each(vmtdir.begin(), vmtdir.end(), printVMT);
-        }
-		
-	    DFMData dfmresources;
-	    
-	    try
-	    {
-		    readDFMResources(pefile, dfmresources);
-		    
-		    if ( printInformation )
-		    {
-                 std::cout << "Recognized DFMs\n\n";
-             
-			for (std::vector<DFMResource*>::iterator Iter = dfmresources.begin(); Iter != dfmresources.end(); ++Iter)
-			{
-				printDfm(*Iter);
-			}
-
-//                 std::for_each(dfmresources.begin(), dfmresources.end(), printDfm);
-            }
-            else
-		    {
-    			synchronize(dfmresources, vmtdir);
-    			obfuscate(dfmresources, vmtdir);
-    			store(filename, dfmresources, vmtdir, pefile);
-            }
-		}
-		catch(const std::string& e)
-		{
-			die(e);
-		}
-		
-		if ( !printInformation )
-		{
-  	    	std::cout << "Everything seems to have worked. Try to start the obfuscated file now." << std::endl;
-        }
-		
-	    return EXIT_SUCCESS;
-	}
-	else
-	{
-		die("Error: File does not seem to be a valid Delphi file.");
-	}
+         PythiaContext context(filename, options);
+         
+         context.scan();
+         context.parseForms();
+         
+         std::cout << "Recognized VMTs: " << context.recognizedVmts() << "\n\n";
+         
+         if ( printInformation && !className.empty() )
+         {
+              VMT* vmt = find<FindByName>(context.vmts(), className);
+              
+              if (!vmt)
+              {
+                   throw std::string("Error: Class " + className + " wasn't found.");
+              }
+              
+              printVMT(std::cout, vmt);
+         }
+         else if ( printInformation )
+         {
+              printModel(std::cout, context.classes(), context.forms());
+         }
+         else
+         {
+              NameMapping previous;
+              
+              if (!mappingFile.empty())
+              {
+                   readMapping(mappingFile, previous);
+              }
+              
+              context.synchronize();
+              
+              if (context.collisions())
+              {
+                   std::cout << context.collisions() << " string values have the same text as a symbol and are not obfuscated\n\n";
+              }
+              
+              context.obfuscate(previous);
+              
+              if (!exportFile.empty())
+              {
+                   PatchSummary summary = context.exportPatches(exportFile);
+                   
+                   std::cout << "Wrote " << summary.patches << " patches (" << summary.bytes << " bytes) to " << exportFile << "\n\n";
+              }
+              else
+              {
+                   PatchSummary summary = context.store(output);
+                   
+                   std::cout << "Changed " << summary.bytes << " bytes in " << summary.patches << " patches\n\n";
+              }
+              
+              if (!mappingFile.empty())
+              {
+                   writeMapping(mappingFile, context.mapping());
+              }
+         }
+    }
+    catch(const std::string& e)
+    {
+         die(e);
+    }
+    
+    reportStatistics(statistics);
+    
+    if ( !printInformation && exportFile.empty() )
+    {
+         std::cout << "Everything seems to have worked. Try to start the obfuscated file now." << std::endl;
+    }
+    
+    return EXIT_SUCCESS;
 }
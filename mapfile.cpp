@@ -0,0 +1,132 @@
+/*
+* mapfile.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "mapfile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : file_(INVALID_HANDLE_VALUE), mapping_(0), data_(0), size_(0) {}
+
+#else
+
+MappedFile::MappedFile() : file_(-1), data_(0), size_(0) {}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/**
+* Maps a file into memory.
+* @param filename Name of the file.
+* @param writable If true, changes to the memory are written to the file.
+* @return True if the file could be mapped.
+**/
+bool MappedFile::open(const std::string& filename, bool writable)
+{
+	close();
+	
+#ifdef _WIN32
+	file_ = CreateFileA(filename.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	
+	if (file_ == INVALID_HANDLE_VALUE) return false;
+	
+	size_ = static_cast<size_t>(GetFileSize(file_, 0));
+	
+	// Empty files can't be mapped.
+	if (size_ == 0) return true;
+	
+	mapping_ = CreateFileMappingA(file_, 0, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, 0);
+	
+	if (!mapping_)
+	{
+		close();
+		return false;
+	}
+	
+	data_ = static_cast<unsigned char*>(MapViewOfFile(mapping_, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+#else
+	file_ = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+	
+	if (file_ == -1) return false;
+	
+	struct stat st;
+	
+	if (fstat(file_, &st))
+	{
+		close();
+		return false;
+	}
+	
+	size_ = static_cast<size_t>(st.st_size);
+	
+	// Empty files can't be mapped.
+	if (size_ == 0) return true;
+	
+	void* data = mmap(0, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file_, 0);
+	data_ = data == MAP_FAILED ? 0 : static_cast<unsigned char*>(data);
+#endif
+
+	if (!data_)
+	{
+		close();
+		return false;
+	}
+	
+	return true;
+}
+
+/**
+* Writes all changes to the mapped memory back to the file.
+* @return True if the changes were written.
+**/
+bool MappedFile::flush()
+{
+	if (!data_) return true;
+	
+#ifdef _WIN32
+	return FlushViewOfFile(data_, 0) && FlushFileBuffers(file_);
+#else
+	return msync(data_, size_, MS_SYNC) == 0;
+#endif
+}
+
+/**
+* Unmaps the file.
+**/
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+	
+	file_ = INVALID_HANDLE_VALUE;
+	mapping_ = 0;
+#else
+	if (data_) munmap(data_, size_);
+	if (file_ != -1) ::close(file_);
+	
+	file_ = -1;
+#endif
+
+	data_ = 0;
+	size_ = 0;
+}
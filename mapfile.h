@@ -0,0 +1,51 @@
+/*
+* mapfile.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+* A file that's mapped into memory.
+**/
+class MappedFile
+{
+	private:
+#ifdef _WIN32
+		HANDLE file_;
+		HANDLE mapping_;
+#else
+		int file_;
+#endif
+		unsigned char* data_;
+		size_t size_;
+		
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+		
+	public:
+		MappedFile();
+		~MappedFile();
+		
+		bool open(const std::string& filename, bool writable = false);
+		bool flush();
+		void close();
+		
+		unsigned char* data() const { return data_; }
+		size_t size() const { return size_; }
+};
+
+#endif
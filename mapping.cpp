@@ -0,0 +1,56 @@
+/*
+* mapping.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "mapping.h"
+
+#include <fstream>
+
+/**
+* Reads a mapping file that was written by a previous run. Each line
+* of the file contains a symbol key and the obfuscated name of the symbol.
+* @param filename Name of the mapping file.
+* @param mapping The entries of the file will be stored here.
+* @return False if the file does not exist (e.g. on the first run).
+**/
+bool readMapping(const std::string& filename, NameMapping& mapping)
+{
+	std::ifstream file(filename.c_str());
+	
+	if (!file) return false;
+	
+	std::string key;
+	std::string value;
+	
+	while (file >> key >> value)
+	{
+		mapping[key] = value;
+	}
+	
+	return true;
+}
+
+/**
+* Writes a mapping file that can be passed to the next run.
+* @param filename Name of the mapping file.
+* @param mapping The mapping to write.
+**/
+void writeMapping(const std::string& filename, const NameMapping& mapping)
+{
+	std::ofstream file(filename.c_str());
+	
+	if (!file) throw std::string("Error: Couldn't write mapping file " + filename + ".");
+	
+	for (NameMapping::const_iterator Iter = mapping.begin(); Iter != mapping.end(); ++Iter)
+	{
+		file << Iter->first << " " << Iter->second << "\n";
+	}
+	
+	if (!file) throw std::string("Error: Couldn't write mapping file " + filename + ".");
+}
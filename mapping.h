@@ -0,0 +1,27 @@
+/*
+* mapping.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef MAPPING_H
+#define MAPPING_H
+
+#include <map>
+#include <string>
+
+/**
+* Maps the key of an obfuscated symbol to the name it was given. Keys
+* have the form "<kind>:<owner>.<name>" (see obfuscate.cpp) and always
+* contain the original, unobfuscated names.
+**/
+typedef std::map<std::string, std::string> NameMapping;
+
+bool readMapping(const std::string& filename, NameMapping& mapping);
+void writeMapping(const std::string& filename, const NameMapping& mapping);
+
+#endif
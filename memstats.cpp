@@ -0,0 +1,275 @@
+/*
+* memstats.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "memstats.h"
+
+#ifdef PYTHIA_ALLOC_STATS
+
+#include "stats.h"
+#include "threads.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+/// Dynamic exception specifications are deprecated since C++11. C++17 removed
+/// throw(std::bad_alloc) and C++20 removed throw().
+#if __cplusplus < 201103L
+#define PYTHIA_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define PYTHIA_NOTHROW throw()
+#else
+#define PYTHIA_THROW_BAD_ALLOC
+#define PYTHIA_NOTHROW noexcept
+#endif
+
+/// Number of the largest allocations that are remembered per phase.
+const unsigned int LARGEST_ALLOCATIONS = 5;
+
+/// Allocations outside of all phases are counted as phase PHASE_COUNT ("other").
+const unsigned int ALLOCATION_PHASES = PHASE_COUNT + 1;
+
+/**
+* Precedes every allocated block. The size is a multiple of 16 to keep
+* the alignment that malloc guarantees.
+**/
+struct AllocationHeader
+{
+	size_t size;
+	unsigned int phase;
+	unsigned int padding[(16 - sizeof(size_t) - sizeof(unsigned int)) / sizeof(unsigned int)];
+};
+
+struct AllocationStatistics
+{
+	unsigned long long count;
+	unsigned long long bytes;
+	unsigned long long live;
+	unsigned long long peak;
+	size_t largest[LARGEST_ALLOCATIONS];
+};
+
+/// All members are zero-initialized before any constructor runs.
+AllocationStatistics g_allocations[ALLOCATION_PHASES];
+unsigned long long g_liveBytes;
+unsigned long long g_peakBytes;
+
+/// operator new can be called before any constructor has run, so the
+/// statistics are protected by a spin lock instead of a Mutex.
+volatile long g_allocationLock;
+
+/// The current phase of the thread plus 1 (0 means no phase).
+PYTHIA_THREAD_LOCAL unsigned int t_allocationPhase;
+
+void lockAllocations()
+{
+#ifdef _WIN32
+	while (InterlockedExchange(&g_allocationLock, 1)) Sleep(0);
+#else
+	while (__sync_lock_test_and_set(&g_allocationLock, 1)) {}
+#endif
+}
+
+void unlockAllocations()
+{
+#ifdef _WIN32
+	InterlockedExchange(&g_allocationLock, 0);
+#else
+	__sync_lock_release(&g_allocationLock);
+#endif
+}
+
+/**
+* Sets the phase that the following allocations of the calling thread
+* are attributed to.
+* @param phase The phase or PHASE_COUNT if no phase is active.
+* @return The previous phase.
+**/
+unsigned int setAllocationPhase(unsigned int phase)
+{
+	unsigned int previous = t_allocationPhase ? t_allocationPhase - 1 : static_cast<unsigned int>(PHASE_COUNT);
+	t_allocationPhase = phase + 1;
+	return previous;
+}
+
+void* allocate(size_t size)
+{
+	AllocationHeader* header = static_cast<AllocationHeader*>(std::malloc(sizeof(AllocationHeader) + size));
+	
+	if (!header) return 0;
+	
+	header->size = size;
+	header->phase = t_allocationPhase ? t_allocationPhase - 1 : static_cast<unsigned int>(PHASE_COUNT);
+	
+	lockAllocations();
+	
+	AllocationStatistics& stats = g_allocations[header->phase];
+	++stats.count;
+	stats.bytes += size;
+	stats.live += size;
+	if (stats.live > stats.peak) stats.peak = stats.live;
+	
+	g_liveBytes += size;
+	if (g_liveBytes > g_peakBytes) g_peakBytes = g_liveBytes;
+	
+	// The list of the largest allocations is sorted in descending order.
+	for (unsigned int i=0;i<LARGEST_ALLOCATIONS;++i)
+	{
+		if (size > stats.largest[i])
+		{
+			for (unsigned int j=LARGEST_ALLOCATIONS - 1;j>i;--j) stats.largest[j] = stats.largest[j - 1];
+			stats.largest[i] = size;
+			break;
+		}
+	}
+	
+	unlockAllocations();
+	
+	return header + 1;
+}
+
+void deallocate(void* p)
+{
+	if (!p) return;
+	
+	AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+	
+	lockAllocations();
+	g_allocations[header->phase].live -= header->size;
+	g_liveBytes -= header->size;
+	unlockAllocations();
+	
+	std::free(header);
+}
+
+void* operator new(size_t size) PYTHIA_THROW_BAD_ALLOC
+{
+	void* p = allocate(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) PYTHIA_THROW_BAD_ALLOC
+{
+	void* p = allocate(size);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) PYTHIA_NOTHROW
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) PYTHIA_NOTHROW
+{
+	return allocate(size);
+}
+
+void operator delete(void* p) PYTHIA_NOTHROW
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p) PYTHIA_NOTHROW
+{
+	deallocate(p);
+}
+
+#if __cplusplus >= 201402L
+// C++14 calls the sized forms when the size of the block is known.
+void operator delete(void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+#endif
+
+void operator delete(void* p, const std::nothrow_t&) PYTHIA_NOTHROW
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) PYTHIA_NOTHROW
+{
+	deallocate(p);
+}
+
+const char* allocationPhaseName(unsigned int phase)
+{
+	return phase < PHASE_COUNT ? phaseName(static_cast<Phase>(phase)) : "other";
+}
+
+/**
+* Prints the number of allocations, the allocated bytes, the peak of live
+* bytes and the largest allocations of each phase.
+* @param stream The output stream.
+* @param json If true the statistics are printed as the members of a JSON object.
+**/
+void printAllocationStatistics(std::ostream& stream, bool json)
+{
+	// Printing allocates, so the statistics are copied first.
+	AllocationStatistics allocations[ALLOCATION_PHASES];
+	
+	lockAllocations();
+	
+	for (unsigned int i=0;i<ALLOCATION_PHASES;++i) allocations[i] = g_allocations[i];
+	unsigned long long peak = g_peakBytes;
+	
+	unlockAllocations();
+	
+	if (json)
+	{
+		stream << "  \"allocations\": {\n";
+		
+		for (unsigned int i=0;i<ALLOCATION_PHASES;++i)
+		{
+			const AllocationStatistics& stats = allocations[i];
+			
+			stream << "    \"" << allocationPhaseName(i) << "\": { \"count\": " << stats.count << ", \"bytes\": " << stats.bytes
+				<< ", \"peak\": " << stats.peak << ", \"largest\": [";
+			
+			for (unsigned int j=0;j<LARGEST_ALLOCATIONS && stats.largest[j];++j)
+			{
+				stream << (j ? ", " : "") << stats.largest[j];
+			}
+			
+			stream << "] },\n";
+		}
+		
+		stream << "    \"peak\": " << peak << "\n  }";
+	}
+	else
+	{
+		stream << "Allocations         Count         Bytes     Peak live  Largest\n";
+		
+		for (unsigned int i=0;i<ALLOCATION_PHASES;++i)
+		{
+			const AllocationStatistics& stats = allocations[i];
+			
+			stream << "  " << std::left << std::setw(12) << allocationPhaseName(i) << std::right << std::setw(11) << stats.count
+				<< std::setw(14) << stats.bytes << std::setw(14) << stats.peak << " ";
+			
+			for (unsigned int j=0;j<LARGEST_ALLOCATIONS && stats.largest[j];++j)
+			{
+				stream << " " << stats.largest[j];
+			}
+			
+			stream << "\n";
+		}
+		
+		stream << "  Peak of live bytes: " << peak << "\n\n";
+	}
+}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+* memstats.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <ostream>
+
+/**
+* Allocation accounting is only compiled in if PYTHIA_ALLOC_STATS is
+* defined. It replaces the global operator new and operator delete and
+* attributes every allocation to the phase (see stats.h) that was active
+* in the allocating thread.
+**/
+#ifdef PYTHIA_ALLOC_STATS
+
+unsigned int setAllocationPhase(unsigned int phase);
+void printAllocationStatistics(std::ostream& stream, bool json);
+
+#else
+
+inline unsigned int setAllocationPhase(unsigned int) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,439 @@
+/*
+* modelcache.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "modelcache.h"
+#include "hash.h"
+#include "mapfile.h"
+#include "pythia.h"
+#include "serialize.h"
+#include "symcache.h"
+
+#include <map>
+
+/**
+* The cache file starts with this header. The cache is only used if the
+* magic value, the format version and the hash of the input file match.
+* The last 8 bytes of the file are the hash of everything before.
+**/
+const unsigned int CACHE_MAGIC = 0x434D5950; // "PYMC"
+
+/// Must be incremented whenever the layout of the cache file changes.
+const unsigned int CACHE_VERSION = 2;
+
+/// Tags of the type of a property.
+enum { TYPE_NONE = 0, TYPE_CLASS = 1, TYPE_NAME = 2 };
+
+/**
+* Writes a DFM property and all its sub-properties.
+* @param writer The output.
+* @param property The property.
+* @param base All offsets are stored relative to this offset.
+**/
+void writeProperty(BinaryWriter& writer, const DFMProperty& property, unsigned int base)
+{
+	writer.u32(property.type);
+	writer.u32(property.offset - base);
+	
+	writer.u32(static_cast<unsigned int>(property.name.size()));
+	for (unsigned int i=0;i<property.name.size();++i) writer.str(*property.name[i]);
+	
+	writer.u32(static_cast<unsigned int>(property.value.size()));
+	for (unsigned int i=0;i<property.value.size();++i) writer.str(*property.value[i]);
+	
+	writer.u32(static_cast<unsigned int>(property.values.size()));
+	for (unsigned int i=0;i<property.values.size();++i) writeProperty(writer, property.values[i], base);
+}
+
+/**
+* Reads a DFM property and all its sub-properties.
+* @param reader The input.
+* @param property The property.
+* @param base This value is added to all stored offsets.
+**/
+void readProperty(BinaryReader& reader, DFMProperty& property, unsigned int base)
+{
+	property.type = reader.u32();
+	property.offset = reader.u32() + base;
+	
+	unsigned int count = reader.u32();
+	for (unsigned int i=0;i<count;++i) property.name.push_back(new std::string(reader.str()));
+	
+	count = reader.u32();
+	for (unsigned int i=0;i<count;++i) property.value.push_back(new std::string(reader.str()));
+	
+	count = reader.u32();
+	property.values.resize(count);
+	for (unsigned int i=0;i<count;++i) readProperty(reader, property.values[i], base);
+}
+
+/**
+* Writes a DFM resource and all its children.
+* @param writer The output.
+* @param dfm The resource.
+* @param base All offsets are stored relative to this offset.
+**/
+void writeResource(BinaryWriter& writer, const DFMResource* dfm, unsigned int base)
+{
+	writer.u32(dfm->offset - base);
+	writer.str(*dfm->name);
+	writer.str(*dfm->classname);
+	
+	writer.u32(static_cast<unsigned int>(dfm->properties.size()));
+	for (unsigned int i=0;i<dfm->properties.size();++i) writeProperty(writer, dfm->properties[i], base);
+	
+	writer.u32(static_cast<unsigned int>(dfm->children.size()));
+	for (unsigned int i=0;i<dfm->children.size();++i) writeResource(writer, dfm->children[i], base);
+}
+
+/**
+* Reads a DFM resource and all its children.
+* @param reader The input.
+* @param parent Parent of the resource (0 for top-level resources).
+* @param base This value is added to all stored offsets.
+* @return The resource.
+**/
+DFMResource* readResource(BinaryReader& reader, DFMResource* parent, unsigned int base)
+{
+	DFMResource* dfm = new DFMResource();
+	dfm->parent = parent;
+	
+	try
+	{
+		dfm->offset = reader.u32() + base;
+		dfm->name = new std::string(reader.str());
+		dfm->classname = new std::string(reader.str());
+		
+		unsigned int count = reader.u32();
+		dfm->properties.resize(count);
+		for (unsigned int i=0;i<count;++i) readProperty(reader, dfm->properties[i], base);
+		
+		count = reader.u32();
+		for (unsigned int i=0;i<count;++i) dfm->children.push_back(readResource(reader, dfm, base));
+	}
+	catch(const std::string&)
+	{
+		// Frees the partially read resource. Children that were read
+		// completely are part of it, the others already freed themselves.
+		VMTDir vmtdir;
+		DFMData partial(1, dfm);
+		release(vmtdir, partial, SymbolCache());
+		throw;
+	}
+	
+	return dfm;
+}
+
+/**
+* Stores the parsed VMT and DFM data of a file in a cache file.
+* @param cachefile Name of the cache file.
+* @param hash Hash of the content of the parsed file.
+* @param vmtdir The VMT data.
+* @param dfmresources The DFM data.
+* @param recognized Number of VMTs that were recognized in the file.
+* @return True if the cache file was written.
+**/
+bool saveModelCache(const std::string& cachefile, unsigned long long hash, const VMTDir& vmtdir, const DFMData& dfmresources, unsigned int recognized)
+{
+	materializeExtraInfo(vmtdir);
+	
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	// Parents always appear before their children in the filled container.
+	std::map<const VMT*, unsigned int> vmtIndex;
+	std::map<const std::string*, unsigned int> nameIndex;
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		vmtIndex[vmts[i]] = i;
+		nameIndex[vmts[i]->name] = i;
+	}
+	
+	BinaryWriter writer;
+	writer.u32(CACHE_MAGIC);
+	writer.u32(CACHE_VERSION);
+	writer.u64(hash);
+	writer.u32(0); // Size of the data, patched below.
+	writer.u32(recognized);
+	writer.u32(static_cast<unsigned int>(vmts.size()));
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		const VMT* vmt = vmts[i];
+		
+		writer.u32(vmt->parent ? vmtIndex[vmt->parent] : 0xFFFFFFFF);
+		writer.u32(vmt->offset);
+		writer.u32(vmt->nameoffset);
+		writer.str(*vmt->name);
+		writer.u32(vmt->parentvmt);
+		
+		writer.u32(vmt->vmtSelfPtr);
+		writer.u32(vmt->vmtIntfTable);
+		writer.u32(vmt->vmtAutoTable);
+		writer.u32(vmt->vmtInitTable);
+		writer.u32(vmt->vmtTypeInfo);
+		writer.u32(vmt->vmtFieldTable);
+		writer.u32(vmt->vmtMethodTable);
+		writer.u32(vmt->vmtDynamicTable);
+		writer.u32(vmt->vmtClassName);
+		writer.u32(vmt->vmtInstanceSize);
+		writer.u32(vmt->vmtParent);
+		writer.u32(vmt->vmtSafeCallException);
+		writer.u32(vmt->vmtAfterConstruction);
+		writer.u32(vmt->vmtBeforeDestruction);
+		writer.u32(vmt->vmtDispatch);
+		writer.u32(vmt->vmtDefaultHandler);
+		writer.u32(vmt->vmtNewInstance);
+		writer.u32(vmt->vmtFreeInstance);
+		writer.u32(vmt->vmtDestroy);
+		
+		writer.u32(static_cast<unsigned int>(vmt->typeinfo.size()));
+		
+		for (unsigned int j=0;j<vmt->typeinfo.size();++j)
+		{
+			const PropInfo& pi = vmt->typeinfo[j];
+			
+			writer.u32(pi.PropType);
+			writer.u32(pi.GetProc);
+			writer.u32(pi.SetProc);
+			writer.u32(pi.StoredProc);
+			writer.u32(pi.Index);
+			writer.u32(pi.Default);
+			writer.u16(pi.NameIndex);
+			writer.str(*pi.name);
+			writer.u32(pi.nameoffset);
+			writer.u32(pi.typeoffset);
+			
+			// Types that are classes share the name object of the class.
+			std::map<const std::string*, unsigned int>::const_iterator Iter = nameIndex.find(pi.type);
+			
+			if (!pi.type)
+			{
+				writer.u8(TYPE_NONE);
+			}
+			else if (Iter != nameIndex.end())
+			{
+				writer.u8(TYPE_CLASS);
+				writer.u32(Iter->second);
+			}
+			else
+			{
+				writer.u8(TYPE_NAME);
+				writer.str(*pi.type);
+			}
+		}
+		
+		writer.u32(static_cast<unsigned int>(vmt->methods.size()));
+		
+		for (unsigned int j=0;j<vmt->methods.size();++j)
+		{
+			writer.u16(vmt->methods[j].id);
+			writer.u32(vmt->methods[j].va);
+			writer.str(*vmt->methods[j].name);
+			writer.u32(vmt->methods[j].nameoffset);
+		}
+		
+		writer.u32(static_cast<unsigned int>(vmt->fields.size()));
+		
+		for (unsigned int j=0;j<vmt->fields.size();++j)
+		{
+			writer.str(*vmt->fields[j].name);
+			writer.u32(vmt->fields[j].nameoffset);
+		}
+	}
+	
+	writer.u32(static_cast<unsigned int>(dfmresources.size()));
+	
+	for (unsigned int i=0;i<dfmresources.size();++i)
+	{
+		writeResource(writer, dfmresources[i], 0);
+	}
+	
+	// The size includes the hash that follows.
+	writer.patchU32(16, static_cast<unsigned int>(writer.size() + 8));
+	
+	writer.u64(hashBytes(&writer.buffer()[0], writer.size()));
+	
+	return writer.save(cachefile);
+}
+
+/**
+* Reads the VMT and DFM data of a file from a cache file.
+**/
+void readModel(BinaryReader& reader, VMTDir& vmtdir, DFMData& dfmresources)
+{
+	unsigned int count = reader.u32();
+	
+	std::vector<VMT*> vmts;
+	
+	// Type references can point to classes that are read later.
+	std::vector<std::pair<std::string**, unsigned int> > classTypes;
+	
+	for (unsigned int i=0;i<count;++i)
+	{
+		VMT* vmt = new VMT();
+		
+		unsigned int parent = reader.u32();
+		
+		if (parent == 0xFFFFFFFF)
+		{
+			vmtdir.push_back(vmt);
+		}
+		else if (parent < vmts.size())
+		{
+			vmt->parent = vmts[parent];
+			vmt->parent->children.push_back(vmt);
+		}
+		else
+		{
+			delete vmt;
+			throw std::string("Error: Invalid parent in model cache.");
+		}
+		
+		vmts.push_back(vmt);
+		
+		vmt->offset = reader.u32();
+		vmt->nameoffset = reader.u32();
+		vmt->name = new std::string(reader.str());
+		vmt->parentvmt = reader.u32();
+		
+		vmt->vmtSelfPtr = reader.u32();
+		vmt->vmtIntfTable = reader.u32();
+		vmt->vmtAutoTable = reader.u32();
+		vmt->vmtInitTable = reader.u32();
+		vmt->vmtTypeInfo = reader.u32();
+		vmt->vmtFieldTable = reader.u32();
+		vmt->vmtMethodTable = reader.u32();
+		vmt->vmtDynamicTable = reader.u32();
+		vmt->vmtClassName = reader.u32();
+		vmt->vmtInstanceSize = reader.u32();
+		vmt->vmtParent = reader.u32();
+		vmt->vmtSafeCallException = reader.u32();
+		vmt->vmtAfterConstruction = reader.u32();
+		vmt->vmtBeforeDestruction = reader.u32();
+		vmt->vmtDispatch = reader.u32();
+		vmt->vmtDefaultHandler = reader.u32();
+		vmt->vmtNewInstance = reader.u32();
+		vmt->vmtFreeInstance = reader.u32();
+		vmt->vmtDestroy = reader.u32();
+		
+		vmt->typeinfo.resize(reader.u32());
+		
+		for (unsigned int j=0;j<vmt->typeinfo.size();++j)
+		{
+			PropInfo& pi = vmt->typeinfo[j];
+			
+			pi.PropType = reader.u32();
+			pi.GetProc = reader.u32();
+			pi.SetProc = reader.u32();
+			pi.StoredProc = reader.u32();
+			pi.Index = reader.u32();
+			pi.Default = reader.u32();
+			pi.NameIndex = reader.u16();
+			pi.name = new std::string(reader.str());
+			pi.nameoffset = reader.u32();
+			pi.typeoffset = reader.u32();
+			
+			unsigned char type = reader.u8();
+			
+			if (type == TYPE_CLASS)
+			{
+				classTypes.push_back(std::make_pair(&pi.type, reader.u32()));
+			}
+			else if (type == TYPE_NAME)
+			{
+				pi.type = new std::string(reader.str());
+			}
+		}
+		
+		vmt->methods.resize(reader.u32());
+		
+		for (unsigned int j=0;j<vmt->methods.size();++j)
+		{
+			vmt->methods[j].id = reader.u16();
+			vmt->methods[j].va = reader.u32();
+			vmt->methods[j].name = new std::string(reader.str());
+			vmt->methods[j].nameoffset = reader.u32();
+		}
+		
+		vmt->fields.resize(reader.u32());
+		
+		for (unsigned int j=0;j<vmt->fields.size();++j)
+		{
+			vmt->fields[j].name = new std::string(reader.str());
+			vmt->fields[j].nameoffset = reader.u32();
+		}
+	}
+	
+	for (unsigned int i=0;i<classTypes.size();++i)
+	{
+		if (classTypes[i].second >= vmts.size()) throw std::string("Error: Invalid type in model cache.");
+		
+		*classTypes[i].first = vmts[classTypes[i].second]->name;
+	}
+	
+	count = reader.u32();
+	
+	for (unsigned int i=0;i<count;++i)
+	{
+		dfmresources.push_back(readResource(reader, 0, 0));
+	}
+}
+
+/**
+* Loads the VMT and DFM data of a file from a cache file. The cache file is
+* mapped into memory and read in place.
+* @param cachefile Name of the cache file.
+* @param hash Hash of the content of the file that's parsed.
+* @param vmtdir The VMT data is stored here.
+* @param dfmresources The DFM data is stored here.
+* @param recognized Receives the number of VMTs that were recognized in the file.
+* @return False if there's no valid cache for the given file.
+**/
+bool loadModelCache(const std::string& cachefile, unsigned long long hash, VMTDir& vmtdir, DFMData& dfmresources, unsigned int& recognized)
+{
+	MappedFile file;
+	
+	if (!file.open(cachefile) || file.size() < 8) return false;
+	
+	// The cached offsets decide where the file is changed, so a damaged
+	// cache must never be used.
+	BinaryReader trailer(file.data() + file.size() - 8, 8);
+	if (trailer.u64() != hashBytes(file.data(), file.size() - 8)) return false;
+	
+	BinaryReader reader(file.data(), file.size() - 8);
+	
+	VMTDir cachedVmts;
+	DFMData cachedDfms;
+	
+	try
+	{
+		if (reader.u32() != CACHE_MAGIC || reader.u32() != CACHE_VERSION || reader.u64() != hash) return false;
+		
+		// Files that were not written completely are ignored.
+		if (reader.u32() != file.size()) return false;
+		
+		unsigned int count = reader.u32();
+		
+		readModel(reader, cachedVmts, cachedDfms);
+		
+		recognized = count;
+	}
+	catch(const std::string&)
+	{
+		release(cachedVmts, cachedDfms, SymbolCache());
+		return false;
+	}
+	
+	vmtdir.insert(vmtdir.end(), cachedVmts.begin(), cachedVmts.end());
+	dfmresources.insert(dfmresources.end(), cachedDfms.begin(), cachedDfms.end());
+	
+	return true;
+}
@@ -0,0 +1,28 @@
+/*
+* modelcache.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include "DFMParser.h"
+#include "VMTDir.h"
+
+#include <string>
+
+class BinaryReader;
+class BinaryWriter;
+
+bool loadModelCache(const std::string& cachefile, unsigned long long hash, VMTDir& vmtdir, DFMData& dfmresources, unsigned int& recognized);
+bool saveModelCache(const std::string& cachefile, unsigned long long hash, const VMTDir& vmtdir, const DFMData& dfmresources, unsigned int recognized);
+
+void writeResource(BinaryWriter& writer, const DFMResource* dfm, unsigned int base);
+DFMResource* readResource(BinaryReader& reader, DFMResource* parent, unsigned int base);
+
+#endif
@@ -10,62 +10,131 @@
 
 #include "obfuscate.h"
 #include "helpers.h"
+#include "stats.h"
+#include "probes.h"
 
 #include <algorithm>
 
 /**
-* Replaces the name element of object x with a random string.
-* @param x The object with the name element.
+* Replaces the name element of objects with random strings. If a previous
+* run already assigned a name to the same symbol that name is reused.
 **/
 template<typename T>
-void obfuscate(T& x)
+class ObfuscateName
 {
-     extern bool showChanges;
-     
-     std::string newvalue = uniqueString<RandomCharacterGenerator>(static_cast<unsigned int>(x.name->length()));
-     
-     if ( showChanges )
-     {
-          std::cout << *x.name << " -> " << newvalue << "\n";
-     }
-     
-     *x.name = newvalue;
-}
+	private:
+		std::string prefix_;
+		const NameMapping& previous_;
+		NameMapping& current_;
+		std::set<std::string>& used_;
+		RandomCharacterGenerator& generator_;
+		std::ostream* changes_;
+		
+	public:
+		/**
+		* @param kind Kind of the symbol (class, property, ...).
+		* @param owner Original name of the class the symbol belongs to.
+		* @param previous Mapping of the previous run.
+		* @param current Mapping of the current run.
+		* @param used All obfuscated names that are already taken.
+		* @param generator Generator of new names.
+		* @param changes The changed names are printed here (may be 0).
+		**/
+		ObfuscateName(const std::string& kind, const std::string& owner, const NameMapping& previous,
+			NameMapping& current, std::set<std::string>& used, RandomCharacterGenerator& generator, std::ostream* changes)
+			: prefix_(kind + ":" + (owner.empty() ? "" : owner + ".")), previous_(previous), current_(current), used_(used),
+			generator_(generator), changes_(changes) {}
+		
+		void operator()(T& x)
+		{
+			std::string key = prefix_ + *x.name;
+			std::string newvalue;
+			
+			NameMapping::const_iterator Iter = current_.find(key);
+			
+			if (Iter != current_.end())
+			{
+				newvalue = Iter->second;
+			}
+			else
+			{
+				Iter = previous_.find(key);
+				
+				// Names of a previous run can only be reused if they still fit.
+				if (Iter != previous_.end() && Iter->second.length() == x.name->length())
+				{
+					newvalue = Iter->second;
+				}
+				else
+				{
+					newvalue = uniqueString(static_cast<unsigned int>(x.name->length()), used_, generator_);
+				}
+				
+				current_[key] = newvalue;
+			}
+			
+			if ( changes_ )
+			{
+				*changes_ << *x.name << " -> " << newvalue << "\n";
+			}
+			
+			PYTHIA_PROBE3(obfuscate__rename, x.name->c_str(), newvalue.c_str(), x.name->length());
+			
+			*x.name = newvalue;
+		}
+};
 
 /**
 * Obfuscates the DFM and VMT data of a Delphi file.
 * @param dfmres The DFM data of an entire Delphi file.
-* @param vmtdir The VMT data of an entire Delphi file.
+* @param classes The VMT data of an entire Delphi file.
+* @param previous Names assigned by a previous run (may be empty).
+* @param current Receives the names assigned by this run.
+* @param generator Generator of the new names.
+* @param changes The changed names are printed here (may be 0).
 **/
-void obfuscate(DFMData& dfmres, VMTDir& vmtdir)
+void obfuscate(DFMData& dfmres, ClassStore& classes, const NameMapping& previous, NameMapping& current,
+	RandomCharacterGenerator& generator, std::ostream* changes)
 {
-	std::deque<VMT*> vmts;
-	fill(vmtdir, vmts);
+	PhaseTimer timer(PHASE_OBFUSCATE);
 	
-    extern bool showChanges;
-    
-    if ( showChanges )
+    if ( changes )
     {
-         std::cout << "Obfuscated strings: \n\n";
+         *changes << "Obfuscated strings: \n\n";
     }
+    
+	// Names of the previous run must not be handed out to new symbols.
+	std::set<std::string> used;
+	
+	for (NameMapping::const_iterator Iter = previous.begin(); Iter != previous.end(); ++Iter)
+	{
+		used.insert(Iter->second);
+	}
 
-	for (std::deque<VMT*>::iterator Iter = vmts.begin(); Iter != vmts.end(); ++Iter)
+	for (std::vector<ClassRecord>::iterator Iter = classes.records.begin(); Iter != classes.records.end(); ++Iter)
 	{
-		if (!isTopElement(dfmres, *(*Iter)->name)) obfuscate<VMT>(**Iter);
+		// Members are keyed by the original name of their class.
+		std::string owner = *Iter->name;
+		
+		if (!isTopElement(dfmres, owner)) ObfuscateName<ClassRecord>("class", "", previous, current, used, generator, changes)(*Iter);
 
-		std::for_each((*Iter)->typeinfo.begin(), (*Iter)->typeinfo.end(), obfuscate<PropInfo>);
-		std::for_each((*Iter)->fields.begin(), (*Iter)->fields.end(), obfuscate<FieldInfo>);
-		std::for_each((*Iter)->methods.begin(), (*Iter)->methods.end(), obfuscate<MethodInfo>);
+		std::vector<PropInfo>::iterator properties = classes.properties.begin() + Iter->firstProperty;
+		std::vector<FieldInfo>::iterator fields = classes.fields.begin() + Iter->firstField;
+		std::vector<MethodInfo>::iterator methods = classes.methods.begin() + Iter->firstMethod;
+		
+		std::for_each(properties, properties + Iter->propertyCount, ObfuscateName<PropInfo>("property", owner, previous, current, used, generator, changes));
+		std::for_each(fields, fields + Iter->fieldCount, ObfuscateName<FieldInfo>("field", owner, previous, current, used, generator, changes));
+		std::for_each(methods, methods + Iter->methodCount, ObfuscateName<MethodInfo>("method", owner, previous, current, used, generator, changes));
 	}
 
 	for (unsigned int i=0;i<dfmres.size();++i)
 	{
-		obfuscate<DFMResource>(*dfmres[i]);
+		ObfuscateName<DFMResource>("form", "", previous, current, used, generator, changes)(*dfmres[i]);
 	}
 	
-    if ( showChanges )
+    if ( changes )
     {
-         std::cout << "\n";
+         *changes << "\n";
     }
 }
 
@@ -11,9 +11,14 @@
 #ifndef OBFUSCATE_H
 #define OBFUSCATE_H
 
-#include "VMTDir.h"
+#include "classstore.h"
 #include "DFMParser.h"
+#include "helpers.h"
+#include "mapping.h"
 
-void obfuscate(DFMData& dfmres, VMTDir& vmtdir);
+#include <ostream>
+
+void obfuscate(DFMData& dfmres, ClassStore& classes, const NameMapping& previous, NameMapping& current,
+	RandomCharacterGenerator& generator, std::ostream* changes = 0);
 
 #endif
@@ -0,0 +1,208 @@
+/*
+* output.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "output.h"
+#include "threads.h"
+
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+#ifndef _WIN32
+
+/**
+* Closes a file descriptor when the object goes out of scope.
+**/
+class FileDescriptor
+{
+	private:
+		int fd_;
+		
+		FileDescriptor(const FileDescriptor&);
+		FileDescriptor& operator=(const FileDescriptor&);
+		
+	public:
+		FileDescriptor(int fd) : fd_(fd) {}
+		~FileDescriptor() { if (fd_ != -1) ::close(fd_); }
+		
+		int get() const { return fd_; }
+};
+
+/**
+* Copies the content of a file with the fastest method the system offers.
+* @return True if the content was copied.
+**/
+bool copyContent(int source, int destination, size_t size)
+{
+#ifdef FICLONE
+	// Copy-on-write clone (btrfs, XFS). No data is copied at all.
+	if (ioctl(destination, FICLONE, source) == 0) return true;
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+	// In-kernel copy that can also use server-side copies on network file systems.
+	size_t copied = 0;
+	
+	while (copied < size)
+	{
+		ssize_t ret = copy_file_range(source, 0, destination, 0, size - copied, 0);
+		if (ret <= 0) break;
+		copied += static_cast<size_t>(ret);
+	}
+	
+	if (copied == size) return true;
+	
+	// Start over with a streamed copy.
+	if (lseek(source, 0, SEEK_SET) == -1 || lseek(destination, 0, SEEK_SET) == -1 || ftruncate(destination, 0)) return false;
+#endif
+
+	std::vector<char> buffer(1 << 20);
+	
+	while (true)
+	{
+		ssize_t ret = read(source, &buffer[0], buffer.size());
+		
+		if (ret == 0) return true;
+		if (ret < 0) return false;
+		
+		for (ssize_t written = 0; written < ret;)
+		{
+			ssize_t w = write(destination, &buffer[written], static_cast<size_t>(ret - written));
+			if (w <= 0) return false;
+			written += w;
+		}
+	}
+}
+
+#endif
+
+/**
+* Creates a name for a temporary file next to a file. The name contains the
+* process ID and a counter so that concurrent runs and threads never pick
+* the same name.
+* @param filename Name of the file.
+* @return Name of the temporary file.
+**/
+std::string temporaryName(const std::string& filename)
+{
+	static volatile unsigned int counter = 0;
+	
+#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+#else
+	unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+
+	std::stringstream ss;
+	ss << filename << "." << pid << "." << atomicAdd(counter, 1) << ".tmp";
+	return ss.str();
+}
+
+/**
+* Copies a file. Where possible the copy shares its data blocks with the
+* original file (reflink) or is made inside the kernel. If the copy fails
+* the partially written destination file is removed.
+* @param source Name of the file to copy.
+* @param destination Name of the copy. The file must not exist yet, existing
+*        files are never overwritten.
+**/
+void copyFile(const std::string& source, const std::string& destination)
+{
+#ifdef _WIN32
+	// CopyFile uses block cloning on file systems that support it.
+	if (!CopyFileA(source.c_str(), destination.c_str(), TRUE))
+	{
+		if (GetLastError() != ERROR_FILE_EXISTS) DeleteFileA(destination.c_str());
+		throw std::string("Error: Couldn't copy file " + source + ".");
+	}
+#else
+	FileDescriptor in(::open(source.c_str(), O_RDONLY));
+	
+	struct stat st;
+	
+	if (in.get() == -1 || fstat(in.get(), &st))
+	{
+		throw std::string("Error: Couldn't open file " + source + ".");
+	}
+	
+	FileDescriptor out(::open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 0777));
+	
+	if (out.get() == -1)
+	{
+		throw std::string("Error: Couldn't create file " + destination + ".");
+	}
+	
+	if (!copyContent(in.get(), out.get(), static_cast<size_t>(st.st_size)))
+	{
+		std::remove(destination.c_str());
+		throw std::string("Error: Couldn't copy file " + source + ".");
+	}
+#endif
+}
+
+/**
+* Makes sure that the content of a file is written to the disk.
+* @param filename Name of the file.
+* @return True if the file was written to the disk.
+**/
+bool syncFile(const std::string& filename)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	
+	bool success = FlushFileBuffers(file) != 0;
+	CloseHandle(file);
+	return success;
+#else
+	FileDescriptor fd(::open(filename.c_str(), O_RDWR));
+	return fd.get() != -1 && fsync(fd.get()) == 0;
+#endif
+}
+
+/**
+* Atomically replaces a file with another file. Readers either see the
+* old or the new file but never a partially written file.
+* @param source The new file. It does not exist anymore afterwards.
+* @param destination The file to replace.
+**/
+void replaceFile(const std::string& source, const std::string& destination)
+{
+#ifdef _WIN32
+	if (!MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		throw std::string("Error: Couldn't replace file " + destination + ".");
+	}
+#else
+	if (rename(source.c_str(), destination.c_str()))
+	{
+		throw std::string("Error: Couldn't replace file " + destination + ".");
+	}
+	
+	// The rename itself is only durable once the directory was written.
+	std::string::size_type slash = destination.rfind('/');
+	std::string directory = slash == std::string::npos ? "." : destination.substr(0, slash + 1);
+	
+	FileDescriptor fd(::open(directory.c_str(), O_RDONLY));
+	if (fd.get() != -1) fsync(fd.get());
+#endif
+}
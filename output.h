@@ -0,0 +1,21 @@
+/*
+* output.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+
+std::string temporaryName(const std::string& filename);
+void copyFile(const std::string& source, const std::string& destination);
+bool syncFile(const std::string& filename);
+void replaceFile(const std::string& source, const std::string& destination);
+
+#endif
@@ -0,0 +1,259 @@
+/*
+* patch.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "patch.h"
+#include "mapfile.h"
+#include "output.h"
+#include "pechecksum.h"
+#include "stats.h"
+#include "probes.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+/**
+* Orders patches by their offset.
+**/
+bool compareOffset(const Patch& p1, const Patch& p2)
+{
+	return p1.offset < p2.offset;
+}
+
+/**
+* Orders patches by the order in which they were added.
+**/
+bool compareSequence(const Patch& p1, const Patch& p2)
+{
+	return p1.sequence < p2.sequence;
+}
+
+/**
+* Reserves memory for patches so that the lists don't grow while the
+* patches are collected.
+* @param patches Number of patches.
+* @param bytes Number of bytes of all patches.
+**/
+void PatchList::reserve(size_t patches, size_t bytes)
+{
+	patches_.reserve(patches);
+	bytes_.reserve(bytes);
+}
+
+/**
+* Copies bytes to the end of the byte buffer.
+* @return The position of the bytes in the buffer.
+**/
+unsigned int PatchList::append(const char* data, unsigned int length)
+{
+	unsigned int position = static_cast<unsigned int>(bytes_.size());
+	bytes_.insert(bytes_.end(), data, data + length);
+	return position;
+}
+
+/**
+* Adds a patch to the list.
+* @param offset File offset where the data is written.
+* @param data The data to write.
+* @param length Number of bytes to write.
+* @param original The data that's expected at the offset (optional, must
+*        have the same length as the data).
+**/
+void PatchList::add(unsigned int offset, const char* data, unsigned int length, const char* original)
+{
+	if (!length) return;
+	
+	Patch patch;
+	patch.offset = offset;
+	patch.length = length;
+	patch.position = append(data, length);
+	patch.original = original ? append(original, length) : Patch::NO_ORIGINAL;
+	patch.sequence = static_cast<unsigned int>(patches_.size());
+	
+	patches_.push_back(patch);
+}
+
+/**
+* Adds a patch to the list.
+* @param offset File offset where the data is written.
+* @param data The data to write.
+**/
+void PatchList::add(unsigned int offset, const std::string& data)
+{
+	add(offset, data.data(), static_cast<unsigned int>(data.size()));
+}
+
+/**
+* Sorts the patches by offset and merges adjacent and overlapping patches.
+* Where patches overlap the patch that was added last wins, just as if the
+* patches were written to the file one after another. The patches are
+* merged in place; the bytes of merged patches are added to the byte buffer.
+**/
+void PatchList::coalesce()
+{
+	std::stable_sort(patches_.begin(), patches_.end(), compareOffset);
+	
+	unsigned int count = 0;
+	
+	for (unsigned int i=0;i<patches_.size();)
+	{
+		unsigned int start = patches_[i].offset;
+		unsigned int end = start + patches_[i].length;
+		
+		unsigned int j = i + 1;
+		
+		while (j < patches_.size() && patches_[j].offset <= end)
+		{
+			end = std::max(end, patches_[j].offset + patches_[j].length);
+			++j;
+		}
+		
+		if (j == i + 1)
+		{
+			patches_[count] = patches_[i];
+		}
+		else
+		{
+			// The group is overwritten by the merged patch, so it can be reordered.
+			std::sort(patches_.begin() + i, patches_.begin() + j, compareSequence);
+			
+			Patch patch;
+			patch.offset = start;
+			patch.length = end - start;
+			patch.position = static_cast<unsigned int>(bytes_.size());
+			patch.original = Patch::NO_ORIGINAL;
+			patch.sequence = patches_[i].sequence;
+			
+			bytes_.resize(bytes_.size() + patch.length);
+			
+			for (unsigned int k=i;k<j;++k)
+			{
+				memcpy(&bytes_[patch.position + patches_[k].offset - start], &bytes_[patches_[k].position], patches_[k].length);
+			}
+			
+			patches_[count] = patch;
+		}
+		
+		++count;
+		i = j;
+	}
+	
+	patches_.resize(count);
+}
+
+/**
+* Writes coalesced patches to a file. The file is mapped into memory and
+* the patches are applied in one pass in the order of their offsets.
+* The PE checksum of the file is updated with the changed bytes.
+* @param filename Name of the file.
+* @param patches The patches. coalesce must have been called before.
+* @return The number of patches and the number of bytes that were changed.
+**/
+PatchSummary applyPatches(const std::string& filename, const PatchList& patches)
+{
+	MappedFile file;
+	
+	if (!file.open(filename, true)) throw std::string("Error: Couldn't open file.");
+	
+	PatchSummary summary;
+	PeChecksum checksum(file.data(), file.size());
+	
+	for (unsigned int i=0;i<patches.size();++i)
+	{
+		const Patch& patch = patches.patches()[i];
+		
+		if (patch.offset > file.size() || patch.length > file.size() - patch.offset)
+		{
+			throw std::string("Error: Couldn't write file.");
+		}
+		
+		unsigned char* target = file.data() + patch.offset;
+		const unsigned char* source = patches.data(patch);
+		const unsigned char* original = patches.original(patch);
+		
+		if (original && memcmp(target, original, patch.length))
+		{
+			throw std::string("Error: File doesn't match the patch.");
+		}
+		
+		unsigned int changed = 0;
+		
+		for (unsigned int j=0;j<patch.length;++j)
+		{
+			if (target[j] != source[j]) ++changed;
+		}
+		
+		// Unchanged regions are not written to avoid dirtying their pages.
+		if (changed)
+		{
+			checksum.update(patch.offset, target, source, patch.length);
+			memcpy(target, source, patch.length);
+			PYTHIA_PROBE3(store__patch, patch.offset, patch.length, changed);
+			++summary.patches;
+			summary.bytes += changed;
+		}
+	}
+	
+	if (summary.patches)
+	{
+		checksum.store(file.data());
+	}
+	
+	addCounter(COUNTER_PATCHES, summary.patches);
+	addCounter(COUNTER_BYTES, summary.bytes);
+	
+	PYTHIA_PROBE2(store__done, summary.patches, summary.bytes);
+	
+	if (!file.flush()) throw std::string("Error: Couldn't write file.");
+	
+	return summary;
+}
+
+/**
+* Writes coalesced patches to a file.
+* @param filename Name of the file to patch.
+* @param output Name of the patched file. If empty the file is modified in
+*        place. Otherwise the patches are written to a copy of the file which
+*        then atomically replaces the output file (which may be the input file).
+* @param patches The patches. coalesce must have been called before.
+* @return The number of patches and the number of bytes that were changed.
+**/
+PatchSummary writePatches(const std::string& filename, const std::string& output, const PatchList& patches)
+{
+	if (output.empty())
+	{
+		return applyPatches(filename, patches);
+	}
+	
+	std::string temporary = temporaryName(output);
+	
+	// Set once the temporary file exists. A file that copyFile didn't
+	// create isn't ours to remove.
+	bool created = false;
+	
+	try
+	{
+		copyFile(filename, temporary);
+		created = true;
+		
+		PatchSummary summary = applyPatches(temporary, patches);
+		
+		if (!syncFile(temporary)) throw std::string("Error: Couldn't write file.");
+		
+		replaceFile(temporary, output);
+		
+		return summary;
+	}
+	catch(const std::string&)
+	{
+		if (created) std::remove(temporary.c_str());
+		throw;
+	}
+}
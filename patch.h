@@ -0,0 +1,86 @@
+/*
+* patch.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <string>
+#include <vector>
+
+/**
+* Bytes that are written to a file at a given offset. The bytes themselves
+* are kept in the byte buffer of the PatchList the patch belongs to.
+**/
+struct Patch
+{
+	unsigned int offset;
+	unsigned int length;
+	
+	/// Position of the new bytes in the byte buffer.
+	unsigned int position;
+	
+	/// Position of the bytes that are replaced in the byte buffer or NO_ORIGINAL.
+	/// If set they are verified before the patch is written.
+	unsigned int original;
+	
+	/// Position of the patch in the order the patches were added.
+	unsigned int sequence;
+	
+	static const unsigned int NO_ORIGINAL = 0xFFFFFFFF;
+};
+
+/**
+* Collects all changes to a file before the file is written.
+**/
+class PatchList
+{
+	private:
+		std::vector<Patch> patches_;
+		
+		/// The bytes of all patches.
+		std::vector<unsigned char> bytes_;
+		
+		unsigned int append(const char* data, unsigned int length);
+		
+	public:
+		void reserve(size_t patches, size_t bytes);
+		void add(unsigned int offset, const char* data, unsigned int length, const char* original = 0);
+		void add(unsigned int offset, const std::string& data);
+		void coalesce();
+		
+		const std::vector<Patch>& patches() const { return patches_; }
+		size_t size() const { return patches_.size(); }
+		
+		/**
+		* The new bytes of a patch.
+		**/
+		const unsigned char* data(const Patch& patch) const { return &bytes_[patch.position]; }
+		
+		/**
+		* The bytes a patch replaces or 0 if they are not known.
+		**/
+		const unsigned char* original(const Patch& patch) const { return patch.original == Patch::NO_ORIGINAL ? 0 : &bytes_[patch.original]; }
+};
+
+/**
+* Describes the changes that were made to a file.
+**/
+struct PatchSummary
+{
+	unsigned int patches;
+	unsigned int bytes;
+	
+	PatchSummary() : patches(0), bytes(0) {}
+};
+
+PatchSummary applyPatches(const std::string& filename, const PatchList& patches);
+PatchSummary writePatches(const std::string& filename, const std::string& output, const PatchList& patches);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+* patchfile.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "patchfile.h"
+#include "hash.h"
+#include "mapfile.h"
+#include "serialize.h"
+#include "stats.h"
+
+#include <cstring>
+
+/**
+* A patch file contains everything that's necessary to obfuscate a file
+* without parsing it again:
+*
+* - Header: magic value, format version, hash and size of the original file
+* - The patches sorted by offset: offset, size, original bytes, new bytes
+* - The names that were assigned (see mapping.h)
+* - The hash of all previous bytes of the patch file
+**/
+const unsigned int PATCH_MAGIC = 0x46505950; // "PYPF"
+
+/// Must be incremented whenever the layout of patch files changes.
+const unsigned int PATCH_VERSION = 1;
+
+/**
+* Writes the changes that are necessary to obfuscate a file to a patch file.
+* @param patchfile Name of the patch file.
+* @param filename Name of the file the patches belong to. The file is not changed.
+* @param patches The patches. coalesce must have been called before.
+* @param mapping The names that were assigned during obfuscation.
+* @return The number of patches and the number of bytes the patch file changes.
+**/
+PatchSummary savePatchFile(const std::string& patchfile, const std::string& filename, const PatchList& patches, const NameMapping& mapping)
+{
+	MappedFile file;
+	
+	if (!file.open(filename)) throw std::string("Error: Couldn't open file " + filename + ".");
+	
+	BinaryWriter writer;
+	writer.u32(PATCH_MAGIC);
+	writer.u32(PATCH_VERSION);
+	writer.u64(hashBytes(file.data(), file.size()));
+	writer.u32(static_cast<unsigned int>(file.size()));
+	writer.u32(0); // Number of patches, patched below.
+	
+	PatchSummary summary;
+	
+	for (unsigned int i=0;i<patches.size();++i)
+	{
+		const Patch& patch = patches.patches()[i];
+		
+		if (patch.offset > file.size() || patch.length > file.size() - patch.offset)
+		{
+			throw std::string("Error: Patch exceeds the file.");
+		}
+		
+		const unsigned char* original = file.data() + patch.offset;
+		const unsigned char* data = patches.data(patch);
+		
+		unsigned int changed = 0;
+		
+		for (unsigned int j=0;j<patch.length;++j)
+		{
+			if (original[j] != data[j]) ++changed;
+		}
+		
+		if (!changed) continue;
+		
+		writer.u32(patch.offset);
+		writer.u32(patch.length);
+		writer.bytes(original, patch.length);
+		writer.bytes(data, patch.length);
+		
+		++summary.patches;
+		summary.bytes += changed;
+	}
+	
+	writer.patchU32(20, summary.patches);
+	
+	writer.u32(static_cast<unsigned int>(mapping.size()));
+	
+	for (NameMapping::const_iterator Iter = mapping.begin(); Iter != mapping.end(); ++Iter)
+	{
+		writer.str(Iter->first);
+		writer.str(Iter->second);
+	}
+	
+	writer.u64(hashBytes(&writer.buffer()[0], writer.size()));
+	
+	if (!writer.save(patchfile)) throw std::string("Error: Couldn't write patch file " + patchfile + ".");
+	
+	return summary;
+}
+
+/**
+* Obfuscates a file with the changes of a patch file. The file must be
+* identical to the file the patch file was made from.
+* @param patchfile Name of the patch file.
+* @param filename Name of the file to patch.
+* @param output Name of the patched file (see writePatches).
+* @param mapping Receives the names that were assigned during obfuscation.
+* @return The number of patches and the number of bytes that were changed.
+**/
+PatchSummary applyPatchFile(const std::string& patchfile, const std::string& filename, const std::string& output, NameMapping& mapping)
+{
+	PhaseTimer timer(PHASE_STORE);
+	
+	PatchList patches;
+	unsigned long long hash;
+	unsigned int size;
+	
+	{
+		MappedFile file;
+		
+		if (!file.open(patchfile)) throw std::string("Error: Couldn't open patch file " + patchfile + ".");
+		
+		if (file.size() < 8 || BinaryReader(file.data() + file.size() - 8, 8).u64() != hashBytes(file.data(), file.size() - 8))
+		{
+			throw std::string("Error: Patch file " + patchfile + " is damaged.");
+		}
+		
+		BinaryReader reader(file.data(), file.size() - 8);
+		
+		if (reader.u32() != PATCH_MAGIC || reader.u32() != PATCH_VERSION)
+		{
+			throw std::string("Error: " + patchfile + " is not a supported patch file.");
+		}
+		
+		hash = reader.u64();
+		size = reader.u32();
+		
+		unsigned int count = reader.u32();
+		
+		// Every patch holds its new and its original bytes.
+		patches.reserve(count, file.size());
+		
+		for (unsigned int i=0;i<count;++i)
+		{
+			unsigned int offset = reader.u32();
+			unsigned int length = reader.u32();
+			
+			const char* original = reinterpret_cast<const char*>(reader.bytes(length));
+			const char* data = reinterpret_cast<const char*>(reader.bytes(length));
+			
+			patches.add(offset, data, length, original);
+		}
+		
+		count = reader.u32();
+		
+		for (unsigned int i=0;i<count;++i)
+		{
+			std::string key = reader.str();
+			mapping[key] = reader.str();
+		}
+	}
+	
+	MappedFile file;
+	
+	if (!file.open(filename)) throw std::string("Error: Couldn't open file " + filename + ".");
+	
+	if (file.size() != size || hashBytes(file.data(), file.size()) != hash)
+	{
+		throw std::string("Error: The patch file was made for a different file.");
+	}
+	
+	file.close();
+	
+	return writePatches(filename, output, patches);
+}
@@ -0,0 +1,22 @@
+/*
+* patchfile.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PATCHFILE_H
+#define PATCHFILE_H
+
+#include "mapping.h"
+#include "patch.h"
+
+#include <string>
+
+PatchSummary savePatchFile(const std::string& patchfile, const std::string& filename, const PatchList& patches, const NameMapping& mapping);
+PatchSummary applyPatchFile(const std::string& patchfile, const std::string& filename, const std::string& output, NameMapping& mapping);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+* pechecksum.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "pechecksum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYTHIA_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+* The PE checksum is the ones' complement sum of all 16-bit little-endian
+* words of the file (the CheckSum field counts as zero) plus the size of
+* the file. Ones' complement addition is associative, so the words can be
+* added in any order and the carries folded back in at the end.
+**/
+
+unsigned int readDword(const unsigned char* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<unsigned int>(data[3]) << 24);
+}
+
+/**
+* Folds a sum of 16-bit words into a 16-bit ones' complement sum.
+**/
+unsigned int fold(unsigned long long sum)
+{
+	while (sum >> 16)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	
+	return static_cast<unsigned int>(sum);
+}
+
+/**
+* Adds up the 16-bit words of a buffer that starts at an even file offset.
+* @param data The buffer.
+* @param size Size of the buffer. A trailing odd byte is the low byte of a word.
+* @return The sum (not folded).
+**/
+unsigned long long sumWords(const unsigned char* data, size_t size)
+{
+	unsigned long long sum = 0;
+	size_t i = 0;
+	
+#ifdef PYTHIA_SSE2
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	
+	while (size - i >= 16)
+	{
+		// Every 32-bit lane grows by at most 2 * 0xFFFF per block of 16 bytes,
+		// so the lanes can't overflow within 16384 blocks.
+		size_t blocks = (size - i) / 16;
+		if (blocks > 16384) blocks = 16384;
+		
+		__m128i acc = _mm_setzero_si128();
+		
+		for (size_t j=0;j<blocks;++j, i+=16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			acc = _mm_add_epi32(acc, _mm_and_si128(v, mask));
+			acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+		}
+		
+		unsigned int lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+		
+		sum += static_cast<unsigned long long>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+
+	for (;i + 1 < size;i+=2)
+	{
+		sum += data[i] | (data[i + 1] << 8);
+	}
+	
+	if (i < size)
+	{
+		sum += data[i];
+	}
+	
+	return sum;
+}
+
+/**
+* Adds up the bytes of a buffer at their positions in the 16-bit words of the file.
+* @param data The buffer.
+* @param size Size of the buffer.
+* @param offset File offset of the buffer.
+* @return The sum (not folded).
+**/
+unsigned long long sumBytes(const unsigned char* data, size_t size, unsigned int offset)
+{
+	if (!size) return 0;
+	
+	if (offset & 1)
+	{
+		return (data[0] << 8) + sumWords(data + 1, size - 1);
+	}
+	
+	return sumWords(data, size);
+}
+
+/**
+* Determines where the CheckSum field of a PE file is.
+* @param data The file.
+* @param size Size of the file.
+* @return The file offset of the CheckSum field or 0 if the file is no PE file.
+**/
+unsigned int checksumOffset(const unsigned char* data, size_t size)
+{
+	if (size < 0x40 || data[0] != 'M' || data[1] != 'Z') return 0;
+	
+	unsigned int pe = readDword(data + 0x3C);
+	
+	// The CheckSum field is at the same place in PE32 and PE32+ files.
+	if (pe > size || size - pe < 0x5C || readDword(data + pe) != 0x4550) return 0;
+	
+	return pe + 0x58;
+}
+
+/**
+* Computes the PE checksum of a file.
+* @param data The file.
+* @param size Size of the file.
+* @return The checksum or 0 if the file is no PE file.
+**/
+unsigned int computeChecksum(const unsigned char* data, size_t size)
+{
+	unsigned int offset = checksumOffset(data, size);
+	
+	if (!offset) return 0;
+	
+	unsigned long long sum = sumBytes(data, offset, 0) + sumBytes(data + offset + 4, size - offset - 4, offset + 4);
+	
+	return fold(sum) + static_cast<unsigned int>(size);
+}
+
+/**
+* Files without a checksum (the CheckSum field is 0, which is what the
+* Delphi linker writes) are left alone. Otherwise the checksum of the
+* unpatched file is computed once, so a stale stored value (for example
+* from a file that was changed by another tool) is never carried over.
+* @param data The file before it's patched.
+* @param size Size of the file.
+**/
+PeChecksum::PeChecksum(const unsigned char* data, size_t size) : offset_(checksumOffset(data, size)), size_(static_cast<unsigned int>(size)), stored_(0), sum_(0)
+{
+	if (!offset_) return;
+	
+	stored_ = readDword(data + offset_);
+	
+	if (stored_) sum_ = computeChecksum(data, size) - size_;
+}
+
+/**
+* Updates the checksum with a patch. Must be called before the patch is written.
+* @param offset File offset of the patch.
+* @param before The bytes that are replaced.
+* @param after The bytes that replace them.
+* @param length Number of bytes.
+**/
+void PeChecksum::update(unsigned int offset, const unsigned char* before, const unsigned char* after, size_t length)
+{
+	if (!offset_ || !stored_) return;
+	
+	size_t skip = 0;
+	
+	// The CheckSum field itself is not part of the checksum.
+	if (offset < offset_ + 4 && offset + length > offset_)
+	{
+		size_t start = offset_ > offset ? offset_ - offset : 0;
+		size_t end = offset_ + 4 - offset < length ? offset_ + 4 - offset : length;
+		
+		update(offset, before, after, start);
+		
+		skip = end;
+	}
+	
+	unsigned int removed = fold(sumBytes(before + skip, length - skip, static_cast<unsigned int>(offset + skip)));
+	unsigned int added = fold(sumBytes(after + skip, length - skip, static_cast<unsigned int>(offset + skip)));
+	
+	// Subtracting in ones' complement arithmetic is adding the complement.
+	sum_ = fold(sum_ + (0xFFFF - removed) + added);
+}
+
+/**
+* Writes the checksum to the CheckSum field. Files without a checksum
+* (the field is 0) keep it that way, a checksum is never added to them.
+* @param data The patched file.
+* @return True if a checksum was written.
+**/
+bool PeChecksum::store(unsigned char* data) const
+{
+	if (!offset_ || !stored_) return false;
+	
+	unsigned int checksum = static_cast<unsigned int>(sum_) + size_;
+	
+	data[offset_] = static_cast<unsigned char>(checksum);
+	data[offset_ + 1] = static_cast<unsigned char>(checksum >> 8);
+	data[offset_ + 2] = static_cast<unsigned char>(checksum >> 16);
+	data[offset_ + 3] = static_cast<unsigned char>(checksum >> 24);
+	
+	return true;
+}
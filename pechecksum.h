@@ -0,0 +1,47 @@
+/*
+* pechecksum.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PECHECKSUM_H
+#define PECHECKSUM_H
+
+#include <cstddef>
+
+unsigned int checksumOffset(const unsigned char* data, size_t size);
+unsigned int computeChecksum(const unsigned char* data, size_t size);
+
+/**
+* Keeps the CheckSum field of the optional header of a file up to date
+* while the file is patched. The file is summed once before it's patched
+* and the sum is then updated with the bytes each patch replaces, so the
+* patched file isn't summed again.
+*
+* Only files that already have a checksum get one. A CheckSum field of 0,
+* which is what the Delphi linker writes, is never filled in: such files
+* still need the checksum pass of the signing tool after obfuscation. A
+* wrong stored checksum is replaced by the correct one.
+**/
+class PeChecksum
+{
+	private:
+		unsigned int offset_;
+		unsigned int size_;
+		unsigned int stored_;
+		
+		/// Folded sum of the file without its size.
+		unsigned long long sum_;
+		
+	public:
+		PeChecksum(const unsigned char* data, size_t size);
+		
+		void update(unsigned int offset, const unsigned char* before, const unsigned char* after, size_t length);
+		bool store(unsigned char* data) const;
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+* perfcounters.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "perfcounters.h"
+#include "stats.h"
+#include "threads.h"
+
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+volatile bool g_perfCounters = false;
+
+/// Events that could be opened by the thread that started the counters.
+bool g_perfAvailable[PERF_EVENT_COUNT];
+
+/**
+* The counters of one thread. Each thread opens its own counters because
+* perf_event_open counters that are not inherited only count the thread
+* that opened them. The events are added to the statistics of the thread
+* (see addPhaseEvents).
+**/
+struct PerfBlock
+{
+	int fds[PERF_EVENT_COUNT];
+};
+
+PYTHIA_THREAD_LOCAL PerfBlock* t_perf;
+
+#ifdef __linux__
+
+/**
+* Opens a counter for the calling thread.
+* @return The file descriptor of the counter or -1 on failure.
+**/
+int openCounter(PerfEvent event)
+{
+	static const unsigned int types[PERF_EVENT_COUNT] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+	};
+	
+	static const unsigned long long configs[PERF_EVENT_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS
+	};
+	
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = types[event];
+	attr.config = configs[event];
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	
+	// Page faults are counted by the kernel.
+	if (event == PERF_PAGE_FAULTS) attr.exclude_kernel = 0;
+	
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+#endif
+
+/**
+* Returns the counters of the calling thread. They are opened on first use.
+**/
+PerfBlock& threadPerf()
+{
+	if (!t_perf)
+	{
+		PerfBlock* block = new PerfBlock();
+		
+		for (unsigned int i=0;i<PERF_EVENT_COUNT;++i)
+		{
+#ifdef __linux__
+			block->fds[i] = openCounter(static_cast<PerfEvent>(i));
+#else
+			block->fds[i] = -1;
+#endif
+		}
+		
+		t_perf = block;
+	}
+	
+	return *t_perf;
+}
+
+/**
+* Closes the counters of the calling thread. Must be called by every thread
+* that may have used the counters before it ends (runThreads does this for
+* its threads).
+**/
+void releasePerfCounters()
+{
+	PerfBlock* block = t_perf;
+	
+	if (!block) return;
+	
+	t_perf = 0;
+	
+#ifdef __linux__
+	for (unsigned int i=0;i<PERF_EVENT_COUNT;++i)
+	{
+		if (block->fds[i] != -1) close(block->fds[i]);
+	}
+#endif
+
+	delete block;
+}
+
+/**
+* Enables counting events per phase. Counters are only available on Linux
+* and may be forbidden (perf_event_paranoid, containers, virtual machines).
+* @return False if no counter at all could be opened.
+**/
+bool startPerfCounters()
+{
+	PerfBlock& block = threadPerf();
+	
+	bool available = false;
+	
+	for (unsigned int i=0;i<PERF_EVENT_COUNT;++i)
+	{
+		g_perfAvailable[i] = block.fds[i] != -1;
+		available = available || g_perfAvailable[i];
+	}
+	
+	g_perfCounters = available;
+	
+	return available;
+}
+
+/**
+* Reads the counters of the calling thread. Counts of counters that were
+* multiplexed with other events are scaled to the full time.
+* @param sample Receives the values. Unavailable counters read as 0.
+**/
+void readPerfCounters(PerfSample& sample)
+{
+	PerfBlock& block = threadPerf();
+	
+	for (unsigned int i=0;i<PERF_EVENT_COUNT;++i)
+	{
+		sample.values[i] = 0;
+		
+#ifdef __linux__
+		unsigned long long data[3];
+		
+		if (block.fds[i] != -1 && read(block.fds[i], data, sizeof(data)) == sizeof(data) && data[2])
+		{
+			sample.values[i] = data[2] < data[1] ? static_cast<unsigned long long>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+		}
+#endif
+	}
+}
+
+/**
+* Prints a ratio or n/a if one of the counters is not available.
+**/
+void printRatio(std::ostream& stream, bool json, PerfEvent numerator, PerfEvent denominator, unsigned long long n, unsigned long long d, double factor, int width)
+{
+	if (json) stream << " ";
+	else stream << std::setw(width);
+	
+	if (!g_perfAvailable[numerator] || !g_perfAvailable[denominator] || !d)
+	{
+		stream << (json ? "null" : "n/a");
+	}
+	else
+	{
+		stream << factor * n / d;
+	}
+}
+
+/**
+* Prints the events, IPC and miss rates (per 1000 instructions) of each phase.
+* @param stream The output stream.
+* @param json If true the statistics are printed as the members of a JSON object.
+* @param totals The events of each phase.
+**/
+void printPerfStatistics(std::ostream& stream, bool json, const unsigned long long totals[][PERF_EVENT_COUNT])
+{
+	static const char* names[PERF_EVENT_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses", "page_faults" };
+	
+	stream << std::fixed << std::setprecision(2);
+	
+	if (json) stream << "  \"perf\": {\n";
+	else stream << "Phase                 Cycles  Instructions    IPC  Cache MPKI  Branch MPKI  Page faults\n";
+	
+	for (unsigned int i=0;i<PHASE_COUNT;++i)
+	{
+		const unsigned long long* t = totals[i];
+		
+		if (json)
+		{
+			stream << "    \"" << phaseName(static_cast<Phase>(i)) << "\": {";
+			
+			for (unsigned int j=0;j<PERF_EVENT_COUNT;++j)
+			{
+				stream << " \"" << names[j] << "\": ";
+				if (g_perfAvailable[j]) stream << t[j];
+				else stream << "null";
+				stream << ",";
+			}
+			
+			stream << " \"ipc\":";
+			printRatio(stream, true, PERF_INSTRUCTIONS, PERF_CYCLES, t[PERF_INSTRUCTIONS], t[PERF_CYCLES], 1, 0);
+			stream << ", \"cache_mpki\":";
+			printRatio(stream, true, PERF_CACHE_MISSES, PERF_INSTRUCTIONS, t[PERF_CACHE_MISSES], t[PERF_INSTRUCTIONS], 1000, 0);
+			stream << ", \"branch_mpki\":";
+			printRatio(stream, true, PERF_BRANCH_MISSES, PERF_INSTRUCTIONS, t[PERF_BRANCH_MISSES], t[PERF_INSTRUCTIONS], 1000, 0);
+			stream << " }" << (i + 1 < PHASE_COUNT ? ",\n" : "\n");
+		}
+		else
+		{
+			stream << "  " << std::left << std::setw(12) << phaseName(static_cast<Phase>(i)) << std::right;
+			
+			for (unsigned int j=0;j<PERF_INSTRUCTIONS + 1;++j)
+			{
+				stream << std::setw(14);
+				if (g_perfAvailable[j]) stream << t[j];
+				else stream << "n/a";
+			}
+			
+			printRatio(stream, false, PERF_INSTRUCTIONS, PERF_CYCLES, t[PERF_INSTRUCTIONS], t[PERF_CYCLES], 1, 7);
+			printRatio(stream, false, PERF_CACHE_MISSES, PERF_INSTRUCTIONS, t[PERF_CACHE_MISSES], t[PERF_INSTRUCTIONS], 1000, 12);
+			printRatio(stream, false, PERF_BRANCH_MISSES, PERF_INSTRUCTIONS, t[PERF_BRANCH_MISSES], t[PERF_INSTRUCTIONS], 1000, 13);
+			
+			stream << std::setw(13);
+			if (g_perfAvailable[PERF_PAGE_FAULTS]) stream << t[PERF_PAGE_FAULTS];
+			else stream << "n/a";
+			
+			stream << "\n";
+		}
+	}
+	
+	if (json) stream << "  }";
+	else stream << "\n";
+}
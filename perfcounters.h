@@ -0,0 +1,44 @@
+/*
+* perfcounters.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <ostream>
+
+/**
+* The hardware and software events that are counted per phase.
+**/
+enum PerfEvent
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_PAGE_FAULTS,
+	PERF_EVENT_COUNT
+};
+
+/**
+* The values of all event counters of a thread at one point in time.
+**/
+struct PerfSample
+{
+	unsigned long long values[PERF_EVENT_COUNT];
+};
+
+extern volatile bool g_perfCounters;
+
+bool startPerfCounters();
+void releasePerfCounters();
+void readPerfCounters(PerfSample& sample);
+void printPerfStatistics(std::ostream& stream, bool json, const unsigned long long totals[][PERF_EVENT_COUNT]);
+
+#endif
@@ -0,0 +1,146 @@
+/*
+* print.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "print.h"
+
+/**
+* Prints the properties, methods and fields of a class. The members are
+* given as ranges of arrays so that both VMTs and ClassStores can use it.
+**/
+void printMembers(std::ostream& stream,
+	const std::vector<PropInfo>& properties, unsigned int firstProperty, unsigned int propertyCount,
+	const std::vector<MethodInfo>& methods, unsigned int firstMethod, unsigned int methodCount,
+	const std::vector<FieldInfo>& fields, unsigned int firstField, unsigned int fieldCount,
+	const std::string& pad)
+{
+     stream << pad << "Properties: " << std::dec << propertyCount << "\n";
+     
+     for (unsigned int i=firstProperty;i<firstProperty + propertyCount;i++)
+     {
+         stream << pad << "  " << *properties[i].type << " " << *properties[i].name << "\n";
+         stream << pad << "    GetProc: " << std::hex << properties[i].GetProc << "\n";
+         stream << pad << "    SetProc: " << std::hex << properties[i].SetProc << "\n";
+         stream << pad << "    StoredProc: " << std::hex << properties[i].StoredProc << "\n";
+     }
+     
+     stream << pad << "Methods: " << std::dec << methodCount << "\n";
+     
+     for (unsigned int i=firstMethod;i<firstMethod + methodCount;i++)
+     {
+         stream << pad << "  Name: " << *methods[i].name << " ( 0x" << std::hex << methods[i].va << " )\n";
+     }
+     
+     stream << pad << "Fields: " << std::dec << fieldCount << "\n";
+     
+     for (unsigned int i=firstField;i<firstField + fieldCount;i++)
+     {
+         stream << pad << "  Name: " << *fields[i].name << "\n";
+     }
+     
+     stream << "\n";
+}
+
+/**
+* Prints a VMT and all VMTs that inherit from it.
+* @param stream The output stream.
+* @param vmt The VMT.
+* @param pad Indentation of the output.
+**/
+void printVMT(std::ostream& stream, const VMT* vmt, std::string pad)
+{
+     ensureExtraInfo(vmt);
+     
+     stream << pad << "Name: " << *vmt->name << "\n";
+     stream << pad << "Offset: 0x" << std::uppercase << std::hex << vmt->offset << "\n";
+     
+     printMembers(stream,
+         vmt->typeinfo, 0, static_cast<unsigned int>(vmt->typeinfo.size()),
+         vmt->methods, 0, static_cast<unsigned int>(vmt->methods.size()),
+         vmt->fields, 0, static_cast<unsigned int>(vmt->fields.size()), pad);
+     
+     for (unsigned int i=0;i<vmt->children.size();i++)
+         printVMT(stream, vmt->children[i], pad + "  ");
+}
+
+/**
+* Prints a class of a ClassStore and all classes that inherit from it. The
+* output is the same as that of printVMT.
+* @param stream The output stream.
+* @param classes The classes.
+* @param index Index of the class.
+* @param pad Indentation of the output.
+**/
+void printClass(std::ostream& stream, const ClassStore& classes, unsigned int index, std::string pad)
+{
+     const ClassRecord& record = classes.records[index];
+     
+     stream << pad << "Name: " << *record.name << "\n";
+     stream << pad << "Offset: 0x" << std::uppercase << std::hex << record.offset << "\n";
+     
+     printMembers(stream,
+         classes.properties, record.firstProperty, record.propertyCount,
+         classes.methods, record.firstMethod, record.methodCount,
+         classes.fields, record.firstField, record.fieldCount, pad);
+     
+     for (unsigned int i=0;i<record.childCount;i++)
+         printClass(stream, classes, record.firstChild + i, pad + "  ");
+}
+
+/**
+* Prints a form or component and all of its children.
+* @param stream The output stream.
+* @param dfm The form or component.
+* @param pad Indentation of the output.
+**/
+void printDfm(std::ostream& stream, const DFMResource* dfm, std::string pad)
+{
+     stream << pad << *dfm->classname << " " << *dfm->name << "\n";
+     
+     stream << pad << "Properties: " << std::dec << dfm->properties.size() << "\n";
+     
+     for (unsigned int i=0;i<dfm->properties.size();i++)
+     {
+          for (unsigned int j=0;j<dfm->properties[i].name.size();j++)
+          {
+              stream << pad << "  " << *dfm->properties[i].name[j] << "\n";
+          }
+          
+//          for (unsigned int j=0;j<dfm->properties[i].value.size();j++)
+//          {
+//              stream << pad << "  " << *dfm->properties[i].value[j] << "\n";
+//          }
+     }
+     
+     stream << "\n";
+     
+     for (unsigned int i=0;i<dfm->children.size();i++)
+         printDfm(stream, dfm->children[i], pad + "  ");
+}
+
+/**
+* Prints all VMTs and forms of a file (the output of -i).
+* @param stream The output stream.
+* @param classes The classes of the file.
+* @param dfmresources The forms of the file.
+**/
+void printModel(std::ostream& stream, const ClassStore& classes, const DFMData& dfmresources)
+{
+	for (unsigned int i=0;i<classes.roots;++i)
+	{
+		printClass(stream, classes, i);
+	}
+	
+	stream << "Recognized DFMs\n\n";
+	
+	for (DFMData::const_iterator Iter = dfmresources.begin(); Iter != dfmresources.end(); ++Iter)
+	{
+		printDfm(stream, *Iter);
+	}
+}
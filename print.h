@@ -0,0 +1,26 @@
+/*
+* print.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PRINT_H
+#define PRINT_H
+
+#include "DFMParser.h"
+#include "VMTDir.h"
+#include "classstore.h"
+
+#include <ostream>
+#include <string>
+
+void printVMT(std::ostream& stream, const VMT* vmt, std::string pad = "");
+void printDfm(std::ostream& stream, const DFMResource* dfm, std::string pad = "");
+void printClass(std::ostream& stream, const ClassStore& classes, unsigned int index, std::string pad = "");
+void printModel(std::ostream& stream, const ClassStore& classes, const DFMData& dfmresources);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+* probes.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+/**
+* Statically defined tracing probes (USDT) for tools like bpftrace,
+* SystemTap or perf. A probe is a single nop instruction until a tracer
+* attaches to it. The probes are compiled in if PYTHIA_USDT is defined
+* and sys/sdt.h (systemtap-sdt-dev) is available, e.g.
+*
+*   bpftrace -e 'usdt:./pythia:pythia:vmt__accept { printf("%s\n", str(arg1)); }'
+*
+* Probes of the provider "pythia":
+*
+* readvmts__start(file name, file size)
+* readvmts__done(candidates, accepted VMTs)
+* vmt__accept(file offset, class name)
+* dfm__resource__start(file offset, size)
+* dfm__resource__done(file offset, form name)
+* sync__start(number of forms)
+* sync__done(number of forms)
+* obfuscate__rename(old name, new name, length)
+* store__patch(file offset, size, changed bytes)
+* store__done(patches, changed bytes)
+**/
+#if defined(PYTHIA_USDT) && !defined(_WIN32)
+
+#include <sys/sdt.h>
+
+#define PYTHIA_PROBE1(name, a) DTRACE_PROBE1(pythia, name, a)
+#define PYTHIA_PROBE2(name, a, b) DTRACE_PROBE2(pythia, name, a, b)
+#define PYTHIA_PROBE3(name, a, b, c) DTRACE_PROBE3(pythia, name, a, b, c)
+
+#else
+
+#define PYTHIA_PROBE1(name, a) do {} while (0)
+#define PYTHIA_PROBE2(name, a, b) do {} while (0)
+#define PYTHIA_PROBE3(name, a, b, c) do {} while (0)
+
+#endif
+
+#endif
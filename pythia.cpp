@@ -0,0 +1,291 @@
+/*
+* pythia.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "pythia.h"
+#include "collisions.h"
+#include "hash.h"
+#include "modelcache.h"
+#include "obfuscate.h"
+#include "stats.h"
+#include "sync.h"
+#include "threads.h"
+#include "write.h"
+
+#include <set>
+
+/**
+* Directs the verbose output, the statistics and the collection lookups of
+* the current thread to a context while one of the steps of the context
+* runs.
+**/
+class ContextScope
+{
+	private:
+		StatisticsScope statistics_;
+		std::ostream* previousLog_;
+		const CollectionTable* previousCollections_;
+		
+	public:
+		ContextScope(const PythiaOptions& options, Statistics& statistics)
+			: statistics_(statistics), previousLog_(verboseLog), previousCollections_(collectionTable)
+		{
+			verboseLog = options.verbose ? options.log : 0;
+			collectionTable = &options.collections;
+		}
+		
+		~ContextScope()
+		{
+			verboseLog = previousLog_;
+			collectionTable = previousCollections_;
+		}
+};
+
+/**
+* Creates a new context for a file.
+* @param filename Name of the file.
+* @param options Settings of the run.
+**/
+PythiaContext::PythiaContext(const std::string& filename, const PythiaOptions& options)
+	: options_(options), pefile_(filename), cache_(options.symbolCache ? options.symbolCache : &ownCache_),
+	statistics_(options.statistics ? options.statistics : &ownStatistics_), classes_(0), generator_(options.seed), hash_(0), cached_(false), obfuscated_(false), recognized_(0), collisions_(0)
+{
+	if (pefile_.readMzHeader() || pefile_.readPeHeader() || pefile_.readResourceDirectory())
+	{
+		throw std::string("Error: File does not seem to be a valid Delphi file.");
+	}
+}
+
+PythiaContext::~PythiaContext()
+{
+	release(vmtdir_, dfmresources_, *cache_, classes_);
+	delete classes_;
+}
+
+/**
+* Searches the file for VMTs. If a model cache was given the VMT and DFM
+* data is taken from the cache if possible.
+**/
+void PythiaContext::scan()
+{
+	ContextScope scope(options_, *statistics_);
+	
+	if (!options_.modelCacheFile.empty())
+	{
+		hash_ = hashFile(pefile_.getFileName());
+		
+		if (loadModelCache(options_.modelCacheFile, hash_, vmtdir_, dfmresources_, recognized_))
+		{
+			addCounter(COUNTER_MODEL_CACHE_HITS);
+			cached_ = true;
+			return;
+		}
+		
+		addCounter(COUNTER_MODEL_CACHE_MISSES);
+	}
+	
+	unsigned int threads = options_.threads ? options_.threads : hardwareThreads();
+	
+	recognized_ = readVMTs(pefile_, vmtdir_, cache_, threads, options_.lazy);
+}
+
+/**
+* Reads the forms of the file and updates the model cache.
+**/
+void PythiaContext::parseForms()
+{
+	ContextScope scope(options_, *statistics_);
+	
+	if (cached_) return;
+	
+	readDFMResources(pefile_, dfmresources_, options_.formCacheDirectory);
+	
+	if (!options_.modelCacheFile.empty() && !saveModelCache(options_.modelCacheFile, hash_, vmtdir_, dfmresources_, recognized_))
+	{
+		*options_.log << "Warning: Couldn't write model cache " << options_.modelCacheFile << "\n";
+	}
+}
+
+/**
+* Connects the names of the forms with the names of the classes and finds
+* the string values that must not be obfuscated.
+**/
+void PythiaContext::synchronize()
+{
+	ContextScope scope(options_, *statistics_);
+	
+	::synchronize(dfmresources_, vmtdir_);
+	
+	if (options_.checkCollisions)
+	{
+		collisions_ = checkStringCollisions(dfmresources_, vmtdir_);
+	}
+}
+
+/**
+* Renames all classes, members and forms.
+* @param previous Names assigned by a previous run (may be empty).
+**/
+void PythiaContext::obfuscate(const NameMapping& previous)
+{
+	ContextScope scope(options_, *statistics_);
+	
+	if (obfuscated_) throw std::string("Error: The file was already obfuscated.");
+	
+	::obfuscate(dfmresources_, classes(), previous, mapping_, generator_, options_.showChanges ? options_.log : 0);
+	
+	obfuscated_ = true;
+}
+
+/**
+* Returns the classes of the file. Must not be called once the members of
+* the classes were moved to the class store (see classes).
+* @return The VMTs of the file.
+**/
+const VMTDir& PythiaContext::vmts() const
+{
+	if (classes_) throw std::string("Error: The classes were moved to the class store.");
+	
+	return vmtdir_;
+}
+
+/**
+* Returns the classes of the file in compact form. The store is created on
+* the first call and takes over the members of the classes, so synchronize
+* must have been called before (if it's called at all).
+* @return The class store.
+**/
+ClassStore& PythiaContext::classes()
+{
+	if (!classes_)
+	{
+		ContextScope scope(options_, *statistics_);
+		
+		classes_ = new ClassStore(vmtdir_);
+	}
+	
+	return *classes_;
+}
+
+/**
+* Writes the obfuscated data back to the file.
+* @param output Name of the file where data is written to (see store in
+*        write.cpp). If empty the file is modified in place.
+* @return The number of patches and the number of bytes that were changed.
+**/
+PatchSummary PythiaContext::store(const std::string& output)
+{
+	ContextScope scope(options_, *statistics_);
+	
+	if (!obfuscated_) throw std::string("Error: The file was not obfuscated yet.");
+	
+	return ::store(pefile_.getFileName(), output, dfmresources_, *classes_, pefile_);
+}
+
+/**
+* Writes the changes that obfuscate the file to a patch file instead of
+* changing the file.
+* @param patchfile Name of the patch file.
+* @return The number of patches and the number of bytes that will be changed.
+**/
+PatchSummary PythiaContext::exportPatches(const std::string& patchfile)
+{
+	ContextScope scope(options_, *statistics_);
+	
+	if (!obfuscated_) throw std::string("Error: The file was not obfuscated yet.");
+	
+	return ::exportPatches(patchfile, pefile_.getFileName(), dfmresources_, *classes_, pefile_, mapping_);
+}
+
+/**
+* Collects the string objects of a DFM property.
+**/
+void collectStrings(const DFMProperty& property, std::set<std::string*>& strings)
+{
+	strings.insert(property.name.begin(), property.name.end());
+	strings.insert(property.value.begin(), property.value.end());
+	
+	for (unsigned int i=0;i<property.values.size();++i)
+	{
+		collectStrings(property.values[i], strings);
+	}
+}
+
+/**
+* Frees the VMT and DFM data of a file. Strings are shared between both
+* trees after synchronization so every string is collected first and
+* deleted exactly once.
+* @param vmtdir VMT data of the file.
+* @param dfmresources DFM data of the file.
+* @param cache Strings owned by this cache are not deleted.
+* @param classes The class store of the VMT data (if one was created). It
+*        holds the members of the classes. The store itself is not freed.
+**/
+void release(VMTDir& vmtdir, DFMData& dfmresources, const SymbolCache& cache, const ClassStore* classes)
+{
+	std::set<std::string*> strings;
+	
+	discardExtraInfo(vmtdir);
+	
+	std::deque<VMT*> vmts;
+	fill(vmtdir, vmts);
+	
+	for (unsigned int i=0;i<vmts.size();++i)
+	{
+		strings.insert(vmts[i]->name);
+		
+		for (unsigned int j=0;j<vmts[i]->typeinfo.size();++j)
+		{
+			strings.insert(vmts[i]->typeinfo[j].name);
+			strings.insert(vmts[i]->typeinfo[j].type);
+		}
+		
+		for (unsigned int j=0;j<vmts[i]->methods.size();++j) strings.insert(vmts[i]->methods[j].name);
+		for (unsigned int j=0;j<vmts[i]->fields.size();++j) strings.insert(vmts[i]->fields[j].name);
+	}
+	
+	if (classes)
+	{
+		for (unsigned int i=0;i<classes->properties.size();++i)
+		{
+			strings.insert(classes->properties[i].name);
+			strings.insert(classes->properties[i].type);
+		}
+		
+		for (unsigned int i=0;i<classes->methods.size();++i) strings.insert(classes->methods[i].name);
+		for (unsigned int i=0;i<classes->fields.size();++i) strings.insert(classes->fields[i].name);
+	}
+	
+	std::deque<DFMResource*> dfms;
+	fill(dfmresources, dfms);
+	
+	for (unsigned int i=0;i<dfms.size();++i)
+	{
+		strings.insert(dfms[i]->name);
+		strings.insert(dfms[i]->classname);
+		
+		for (unsigned int j=0;j<dfms[i]->properties.size();++j)
+		{
+			collectStrings(dfms[i]->properties[j], strings);
+		}
+	}
+	
+	strings.erase(0);
+	
+	for (std::set<std::string*>::iterator Iter = strings.begin(); Iter != strings.end(); ++Iter)
+	{
+		if (!cache.owns(*Iter)) delete *Iter;
+	}
+	
+	for (unsigned int i=0;i<dfms.size();++i) delete dfms[i];
+	for (unsigned int i=0;i<vmtdir.size();++i) delete vmtdir[i];
+	
+	vmtdir.clear();
+	dfmresources.clear();
+}
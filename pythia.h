@@ -0,0 +1,148 @@
+/*
+* pythia.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef PYTHIA_H
+#define PYTHIA_H
+
+#include "DFMParser.h"
+#include "VMTDir.h"
+#include "classstore.h"
+#include "collections.h"
+#include "helpers.h"
+#include "mapping.h"
+#include "patch.h"
+#include "stats.h"
+#include "symcache.h"
+
+#include <iostream>
+#include <string>
+
+/**
+* Settings of an obfuscation run.
+**/
+struct PythiaOptions
+{
+	/// Print the obfuscated names to the log.
+	bool showChanges;
+	
+	/// Print details of the analysis to the log.
+	bool verbose;
+	
+	/// Leave string values alone that have the same text as a symbol.
+	bool checkCollisions;
+	
+	/// Read the members of a class only when they are needed.
+	bool lazy;
+	
+	/// Number of threads that read the classes (0 for one per processor).
+	unsigned int threads;
+	
+	/// Seed of the name generator.
+	unsigned int seed;
+	
+	/// Directory of the form cache (empty if no cache is used).
+	std::string formCacheDirectory;
+	
+	/// File that caches the parsed data (empty if no cache is used).
+	std::string modelCacheFile;
+	
+	/// The item classes of the collections (see readCollectionFile).
+	CollectionTable collections;
+	
+	/// Cache that's shared with other runs (if 0 the run uses its own cache).
+	SymbolCache* symbolCache;
+	
+	/// Statistics that are shared with other runs (if 0 the run keeps its own).
+	Statistics* statistics;
+	
+	/// Where changes, details and warnings are printed.
+	std::ostream* log;
+	
+	PythiaOptions() : showChanges(false), verbose(false), checkCollisions(true), lazy(false),
+		threads(0), seed(0), collections(createCollectionTable()), symbolCache(0), statistics(0), log(&std::cout) {}
+};
+
+/**
+* A single obfuscation run of a file. The context owns everything the run
+* needs (its settings, the parsed data, the names, the name generator and
+* the statistics), so several contexts can be used in parallel as long as
+* each context is only used by one thread at a time. A symbol cache or
+* statistics given in the options are shared with the other contexts that
+* use them. Only the trace (--trace) and the allocation statistics
+* (PYTHIA_ALLOC_STATS) are kept for the whole process.
+*
+* The steps have to be called in this order: scan, parseForms, synchronize,
+* obfuscate and store (or exportPatches). Errors are thrown as strings.
+* Once obfuscate or classes was called, the members of the classes are only
+* available through the class store and vmts can't be used any more.
+**/
+class PythiaContext
+{
+	private:
+		PythiaOptions options_;
+		PeLib::PeFile32 pefile_;
+		SymbolCache ownCache_;
+		SymbolCache* cache_;
+		Statistics ownStatistics_;
+		Statistics* statistics_;
+		VMTDir vmtdir_;
+		DFMData dfmresources_;
+		ClassStore* classes_;
+		NameMapping mapping_;
+		RandomCharacterGenerator generator_;
+		
+		/// Hash of the file (only used with a model cache).
+		unsigned long long hash_;
+		
+		/// True if the data was taken from the model cache.
+		bool cached_;
+		
+		/// True once obfuscate was called.
+		bool obfuscated_;
+		
+		unsigned int recognized_;
+		unsigned int collisions_;
+		
+		PythiaContext(const PythiaContext&);
+		PythiaContext& operator=(const PythiaContext&);
+		
+	public:
+		PythiaContext(const std::string& filename, const PythiaOptions& options);
+		~PythiaContext();
+		
+		void scan();
+		void parseForms();
+		void synchronize();
+		void obfuscate(const NameMapping& previous);
+		PatchSummary store(const std::string& output);
+		PatchSummary exportPatches(const std::string& patchfile);
+		
+		const VMTDir& vmts() const;
+		ClassStore& classes();
+		
+		/// The forms of the file.
+		const DFMData& forms() const { return dfmresources_; }
+		
+		/// The names that were assigned by obfuscate.
+		const NameMapping& mapping() const { return mapping_; }
+		
+		/// Number of VMTs that were recognized by scan.
+		unsigned int recognizedVmts() const { return recognized_; }
+		
+		/// Number of string values that are not obfuscated (see synchronize).
+		unsigned int collisions() const { return collisions_; }
+		
+		/// The phase times and counters of the run.
+		const Statistics& statistics() const { return *statistics_; }
+};
+
+void release(VMTDir& vmtdir, DFMData& dfmresources, const SymbolCache& cache, const ClassStore* classes = 0);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+* serialize.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "serialize.h"
+#include "threads.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+void BinaryWriter::u8(unsigned char value)
+{
+	buffer_.push_back(value);
+}
+
+void BinaryWriter::u16(unsigned short value)
+{
+	u8(static_cast<unsigned char>(value));
+	u8(static_cast<unsigned char>(value >> 8));
+}
+
+void BinaryWriter::u32(unsigned int value)
+{
+	u16(static_cast<unsigned short>(value));
+	u16(static_cast<unsigned short>(value >> 16));
+}
+
+void BinaryWriter::u64(unsigned long long value)
+{
+	u32(static_cast<unsigned int>(value));
+	u32(static_cast<unsigned int>(value >> 32));
+}
+
+void BinaryWriter::bytes(const unsigned char* data, size_t size)
+{
+	buffer_.insert(buffer_.end(), data, data + size);
+}
+
+/**
+* Writes a string with a leading 32-bit length.
+**/
+void BinaryWriter::str(const std::string& value)
+{
+	u32(static_cast<unsigned int>(value.length()));
+	bytes(reinterpret_cast<const unsigned char*>(value.data()), value.length());
+}
+
+/**
+* Overwrites a 32-bit value that was written before (e.g. a size that was
+* not known when the value was written).
+**/
+void BinaryWriter::patchU32(size_t position, unsigned int value)
+{
+	for (unsigned int i=0;i<4;++i)
+	{
+		buffer_[position + i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+}
+
+/**
+* Writes the buffer to a file. The data is first written to a temporary
+* file which then replaces the file so readers never see half a file.
+* @param filename Name of the file.
+* @return True if the file was written.
+**/
+bool BinaryWriter::save(const std::string& filename) const
+{
+	static volatile unsigned int counter = 0;
+	
+	// Several threads may write the same file at the same time.
+	std::stringstream ss;
+	ss << filename << "." << atomicAdd(counter, 1) << ".tmp";
+	std::string temporary = ss.str();
+	
+	bool written;
+	
+	{
+		std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		
+		if (buffer_.size()) file.write(reinterpret_cast<const char*>(&buffer_[0]), static_cast<std::streamsize>(buffer_.size()));
+		
+		written = file.good();
+	}
+	
+	// rename doesn't replace existing files on Windows.
+	if (written) std::remove(filename.c_str());
+	
+	if (!written || std::rename(temporary.c_str(), filename.c_str()))
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+	
+	return true;
+}
+
+const unsigned char* BinaryReader::take(size_t size)
+{
+	if (size > size_ - position_) throw std::string("Error: Unexpected end of data.");
+	
+	const unsigned char* ptr = data_ + position_;
+	position_ += size;
+	return ptr;
+}
+
+unsigned char BinaryReader::u8()
+{
+	return *take(1);
+}
+
+unsigned short BinaryReader::u16()
+{
+	const unsigned char* ptr = take(2);
+	return static_cast<unsigned short>(ptr[0] | (ptr[1] << 8));
+}
+
+unsigned int BinaryReader::u32()
+{
+	unsigned int low = u16();
+	unsigned int high = u16();
+	return low | (high << 16);
+}
+
+unsigned long long BinaryReader::u64()
+{
+	unsigned long long low = u32();
+	unsigned long long high = u32();
+	return low | (high << 32);
+}
+
+const unsigned char* BinaryReader::bytes(size_t size)
+{
+	return take(size);
+}
+
+std::string BinaryReader::str()
+{
+	size_t length = u32();
+	const unsigned char* ptr = take(length);
+	return std::string(reinterpret_cast<const char*>(ptr), length);
+}
@@ -0,0 +1,69 @@
+/*
+* serialize.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+* Writes values in a little-endian binary format to a buffer.
+**/
+class BinaryWriter
+{
+	private:
+		std::vector<unsigned char> buffer_;
+		
+	public:
+		void u8(unsigned char value);
+		void u16(unsigned short value);
+		void u32(unsigned int value);
+		void u64(unsigned long long value);
+		void bytes(const unsigned char* data, size_t size);
+		void str(const std::string& value);
+		
+		void patchU32(size_t position, unsigned int value);
+		
+		const std::vector<unsigned char>& buffer() const { return buffer_; }
+		size_t size() const { return buffer_.size(); }
+		
+		bool save(const std::string& filename) const;
+};
+
+/**
+* Reads values that were written by a BinaryWriter. Reading beyond the
+* end of the data throws an exception of type std::string.
+**/
+class BinaryReader
+{
+	private:
+		const unsigned char* data_;
+		size_t size_;
+		size_t position_;
+		
+		const unsigned char* take(size_t size);
+		
+	public:
+		BinaryReader(const unsigned char* data, size_t size) : data_(data), size_(size), position_(0) {}
+		
+		unsigned char u8();
+		unsigned short u16();
+		unsigned int u32();
+		unsigned long long u64();
+		const unsigned char* bytes(size_t size);
+		std::string str();
+		
+		size_t position() const { return position_; }
+		size_t remaining() const { return size_ - position_; }
+};
+
+#endif
@@ -0,0 +1,372 @@
+/*
+* stats.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "stats.h"
+#include "threads.h"
+#include "trace.h"
+#include "memstats.h"
+
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/**
+* The statistics that one thread collected for one Statistics object.
+**/
+struct StatisticsBlock
+{
+	Statistics* owner;
+	unsigned long long time[PHASE_COUNT];
+	unsigned long long calls[PHASE_COUNT];
+	unsigned long long events[PHASE_COUNT][PERF_EVENT_COUNT];
+	unsigned long long counters[COUNTER_COUNT];
+	StatisticsBlock* next;
+};
+
+/// The block the calling thread writes to.
+PYTHIA_THREAD_LOCAL StatisticsBlock* t_statistics;
+
+/// The statistics of the work that's done outside of any StatisticsScope.
+Statistics g_processStatistics;
+
+Statistics::Statistics() : blocks_(0)
+{
+}
+
+Statistics::~Statistics()
+{
+	while (blocks_)
+	{
+		StatisticsBlock* next = blocks_->next;
+		delete blocks_;
+		blocks_ = next;
+	}
+}
+
+/**
+* Creates the block of a thread that works for these statistics. The
+* block is freed together with the statistics.
+* @return The new block.
+**/
+StatisticsBlock* Statistics::createBlock()
+{
+	StatisticsBlock* block = new StatisticsBlock();
+	block->owner = this;
+	
+	ScopedLock lock(mutex_);
+	block->next = blocks_;
+	blocks_ = block;
+	
+	return block;
+}
+
+StatisticsScope::StatisticsScope(Statistics& statistics) : previous_(t_statistics)
+{
+	// Nested scopes of the same statistics share the block.
+	if (!previous_ || previous_->owner != &statistics) t_statistics = statistics.createBlock();
+}
+
+StatisticsScope::~StatisticsScope()
+{
+	t_statistics = previous_;
+}
+
+/**
+* Returns the statistics the calling thread adds to.
+**/
+Statistics& currentStatistics()
+{
+	return t_statistics ? *t_statistics->owner : g_processStatistics;
+}
+
+/**
+* Returns the block the calling thread adds to.
+**/
+StatisticsBlock& threadStatistics()
+{
+	if (!t_statistics) t_statistics = g_processStatistics.createBlock();
+	
+	return *t_statistics;
+}
+
+const char* phaseName(Phase phase)
+{
+	static const char* names[PHASE_COUNT] = { "scan", "fix", "extrainfo", "dfm", "sync", "collisions", "obfuscate", "store" };
+	
+	return names[phase];
+}
+
+const char* counterName(Counter counter)
+{
+	static const char* names[COUNTER_COUNT] = {
+		"candidates", "vmts", "methods", "fields", "properties",
+		"dfm_resources", "dfm_properties", "name_lookups", "string_collisions",
+		"model_cache_hits", "model_cache_misses", "form_cache_hits", "form_cache_misses",
+		"symbol_cache_hits", "symbol_cache_misses", "type_cache_hits", "type_cache_misses",
+		"deferred_vmts", "attribute_cache_hits", "attribute_cache_misses",
+		"patches", "bytes"
+	};
+	
+	return names[counter];
+}
+
+/**
+* Returns the value of a monotonic clock in nanoseconds.
+**/
+unsigned long long monotonicTime()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+	
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	
+	// Split to avoid an overflow of counter * 10^9.
+	unsigned long long seconds = counter.QuadPart / frequency.QuadPart;
+	unsigned long long rest = counter.QuadPart % frequency.QuadPart;
+	
+	return seconds * 1000000000ULL + rest * 1000000000ULL / frequency.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+void addPhaseTime(Phase phase, unsigned long long nanoseconds)
+{
+	StatisticsBlock& block = threadStatistics();
+	block.time[phase] += nanoseconds;
+	++block.calls[phase];
+}
+
+/**
+* Adds the performance counter events between two samples of the calling
+* thread to a phase.
+**/
+void addPhaseEvents(Phase phase, const PerfSample& begin, const PerfSample& end)
+{
+	unsigned long long* events = threadStatistics().events[phase];
+	
+	for (unsigned int i=0;i<PERF_EVENT_COUNT;++i)
+	{
+		if (end.values[i] > begin.values[i]) events[i] += end.values[i] - begin.values[i];
+	}
+}
+
+void addCounter(Counter counter, unsigned long long value)
+{
+	threadStatistics().counters[counter] += value;
+}
+
+/// The innermost running timer of the calling thread.
+PYTHIA_THREAD_LOCAL PhaseTimer* t_phaseTimer;
+
+PhaseTimer::PhaseTimer(Phase phase) : phase_(phase), start_(monotonicTime()), nested_(0), previousAllocationPhase_(setAllocationPhase(phase)), outer_(t_phaseTimer)
+{
+	t_phaseTimer = this;
+	
+	if (g_perfCounters)
+	{
+		readPerfCounters(perfStart_);
+		
+		// The events of the outer phase end here and start again when this
+		// timer is destroyed.
+		if (outer_) addPhaseEvents(outer_->phase_, outer_->perfStart_, perfStart_);
+	}
+}
+
+PhaseTimer::~PhaseTimer()
+{
+	unsigned long long now = monotonicTime();
+	
+	addPhaseTime(phase_, now - start_ - nested_);
+	addTraceEvent(phaseName(phase_), "", start_, now);
+	setAllocationPhase(previousAllocationPhase_);
+	
+	t_phaseTimer = outer_;
+	if (outer_) outer_->nested_ += now - start_;
+	
+	if (g_perfCounters)
+	{
+		PerfSample end;
+		readPerfCounters(end);
+		addPhaseEvents(phase_, perfStart_, end);
+		
+		if (outer_) outer_->perfStart_ = end;
+	}
+}
+
+/**
+* Ends the current phase and starts measuring another one.
+* @param phase The next phase.
+**/
+void PhaseTimer::switchTo(Phase phase)
+{
+	unsigned long long now = monotonicTime();
+	
+	addPhaseTime(phase_, now - start_ - nested_);
+	addTraceEvent(phaseName(phase_), "", start_, now);
+	
+	if (g_perfCounters)
+	{
+		PerfSample end;
+		readPerfCounters(end);
+		addPhaseEvents(phase_, perfStart_, end);
+		perfStart_ = end;
+	}
+	
+	phase_ = phase;
+	start_ = now;
+	nested_ = 0;
+	
+	setAllocationPhase(phase);
+}
+
+/**
+* Returns the time that all threads spent in a phase in nanoseconds.
+**/
+unsigned long long Statistics::phaseTime(Phase phase) const
+{
+	ScopedLock lock(mutex_);
+	
+	unsigned long long sum = 0;
+	for (StatisticsBlock* block = blocks_; block; block = block->next) sum += block->time[phase];
+	return sum;
+}
+
+/**
+* Returns how often a phase was run.
+**/
+unsigned long long Statistics::phaseCalls(Phase phase) const
+{
+	ScopedLock lock(mutex_);
+	
+	unsigned long long sum = 0;
+	for (StatisticsBlock* block = blocks_; block; block = block->next) sum += block->calls[phase];
+	return sum;
+}
+
+unsigned long long Statistics::counterValue(Counter counter) const
+{
+	ScopedLock lock(mutex_);
+	
+	unsigned long long sum = 0;
+	for (StatisticsBlock* block = blocks_; block; block = block->next) sum += block->counters[counter];
+	return sum;
+}
+
+/**
+* Prints the time spent in each phase, all counters and the performance
+* counter events. The allocation statistics (PYTHIA_ALLOC_STATS) are those
+* of the whole process. Must not be called while other threads are still
+* working for these statistics.
+* @param stream The output stream.
+* @param json If true the statistics are printed as a JSON object.
+**/
+void Statistics::print(std::ostream& stream, bool json) const
+{
+	unsigned long long events[PHASE_COUNT][PERF_EVENT_COUNT] = { { 0 } };
+	
+	if (g_perfCounters)
+	{
+		ScopedLock lock(mutex_);
+		
+		for (StatisticsBlock* block = blocks_; block; block = block->next)
+		{
+			for (unsigned int i=0;i<PHASE_COUNT;++i)
+			{
+				for (unsigned int j=0;j<PERF_EVENT_COUNT;++j) events[i][j] += block->events[i][j];
+			}
+		}
+	}
+	
+
+	std::ios::fmtflags flags = stream.flags();
+	stream << std::dec << std::fixed << std::setprecision(3);
+	
+	if (json)
+	{
+		stream << "{\n  \"phases\": {\n";
+		
+		for (unsigned int i=0;i<PHASE_COUNT;++i)
+		{
+			Phase phase = static_cast<Phase>(i);
+			stream << "    \"" << phaseName(phase) << "\": { \"ms\": " << phaseTime(phase) / 1e6 << ", \"calls\": " << phaseCalls(phase) << " }";
+			stream << (i + 1 < PHASE_COUNT ? ",\n" : "\n");
+		}
+		
+		stream << "  },\n  \"counters\": {\n";
+		
+		for (unsigned int i=0;i<COUNTER_COUNT;++i)
+		{
+			Counter counter = static_cast<Counter>(i);
+			stream << "    \"" << counterName(counter) << "\": " << counterValue(counter);
+			stream << (i + 1 < COUNTER_COUNT ? ",\n" : "\n");
+		}
+		
+		stream << "  }";
+		
+		if (g_perfCounters)
+		{
+			stream << ",\n";
+			printPerfStatistics(stream, true, events);
+		}
+		
+#ifdef PYTHIA_ALLOC_STATS
+		stream << ",\n";
+		printAllocationStatistics(stream, true);
+#endif
+
+		stream << "\n}\n";
+	}
+	else
+	{
+		stream << "Phase                 Time (ms)     Calls\n";
+		
+		unsigned long long total = 0;
+		
+		for (unsigned int i=0;i<PHASE_COUNT;++i)
+		{
+			Phase phase = static_cast<Phase>(i);
+			total += phaseTime(phase);
+			stream << "  " << std::left << std::setw(16) << phaseName(phase) << std::right << std::setw(12) << phaseTime(phase) / 1e6 << std::setw(10) << phaseCalls(phase) << "\n";
+		}
+		
+		stream << "  " << std::left << std::setw(16) << "total" << std::right << std::setw(12) << total / 1e6 << "\n\n";
+		
+		stream << "Counter                   Value\n";
+		
+		for (unsigned int i=0;i<COUNTER_COUNT;++i)
+		{
+			Counter counter = static_cast<Counter>(i);
+			stream << "  " << std::left << std::setw(20) << counterName(counter) << std::right << std::setw(10) << counterValue(counter) << "\n";
+		}
+		
+		stream << "\n";
+		
+		if (g_perfCounters)
+		{
+			printPerfStatistics(stream, false, events);
+		}
+		
+#ifdef PYTHIA_ALLOC_STATS
+		printAllocationStatistics(stream, false);
+#endif
+	}
+	
+	stream.flags(flags);
+}
@@ -0,0 +1,149 @@
+/*
+* stats.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "perfcounters.h"
+#include "threads.h"
+
+#include <ostream>
+
+/**
+* The phases of an obfuscation run.
+**/
+enum Phase
+{
+	PHASE_SCAN,
+	PHASE_FIX,
+	PHASE_EXTRAINFO,
+	PHASE_DFM,
+	PHASE_SYNC,
+	PHASE_COLLISIONS,
+	PHASE_OBFUSCATE,
+	PHASE_STORE,
+	PHASE_COUNT
+};
+
+/**
+* The things that are counted during a run.
+**/
+enum Counter
+{
+	COUNTER_CANDIDATES,
+	COUNTER_VMTS,
+	COUNTER_METHODS,
+	COUNTER_FIELDS,
+	COUNTER_PROPERTIES,
+	COUNTER_DFM_RESOURCES,
+	COUNTER_DFM_PROPERTIES,
+	COUNTER_NAME_LOOKUPS,
+	COUNTER_COLLISIONS,
+	COUNTER_MODEL_CACHE_HITS,
+	COUNTER_MODEL_CACHE_MISSES,
+	COUNTER_FORM_CACHE_HITS,
+	COUNTER_FORM_CACHE_MISSES,
+	COUNTER_SYMBOL_CACHE_HITS,
+	COUNTER_SYMBOL_CACHE_MISSES,
+	COUNTER_TYPE_CACHE_HITS,
+	COUNTER_TYPE_CACHE_MISSES,
+	COUNTER_DEFERRED_VMTS,
+	COUNTER_ATTRIBUTE_CACHE_HITS,
+	COUNTER_ATTRIBUTE_CACHE_MISSES,
+	COUNTER_PATCHES,
+	COUNTER_BYTES,
+	COUNTER_COUNT
+};
+
+const char* phaseName(Phase phase);
+const char* counterName(Counter counter);
+
+unsigned long long monotonicTime();
+
+struct StatisticsBlock;
+
+/**
+* The phase times, counters and performance counter events of one or more
+* obfuscation runs. Every thread that works for the runs writes to its own
+* block, so counting needs neither locks nor atomic operations. The blocks
+* are added up when the statistics are read.
+**/
+class Statistics
+{
+	private:
+		StatisticsBlock* blocks_;
+		mutable Mutex mutex_;
+		
+		Statistics(const Statistics&);
+		Statistics& operator=(const Statistics&);
+		
+	public:
+		Statistics();
+		~Statistics();
+		
+		StatisticsBlock* createBlock();
+		
+		unsigned long long phaseTime(Phase phase) const;
+		unsigned long long phaseCalls(Phase phase) const;
+		unsigned long long counterValue(Counter counter) const;
+		
+		void print(std::ostream& stream, bool json) const;
+};
+
+/**
+* Makes the calling thread add its phase times and counters to a Statistics
+* object for the lifetime of the scope. Threads outside of any scope add to
+* the statistics of the process.
+**/
+class StatisticsScope
+{
+	private:
+		StatisticsBlock* previous_;
+		
+		StatisticsScope(const StatisticsScope&);
+		StatisticsScope& operator=(const StatisticsScope&);
+		
+	public:
+		StatisticsScope(Statistics& statistics);
+		~StatisticsScope();
+};
+
+Statistics& currentStatistics();
+
+void addPhaseTime(Phase phase, unsigned long long nanoseconds);
+void addPhaseEvents(Phase phase, const PerfSample& begin, const PerfSample& end);
+void addCounter(Counter counter, unsigned long long value = 1);
+
+/**
+* Measures the time of a phase from its construction to its destruction.
+* Timers can be nested. The time of the inner timer is billed only to its
+* own phase and not to the phase of the outer one.
+**/
+class PhaseTimer
+{
+	private:
+		Phase phase_;
+		unsigned long long start_;
+		unsigned long long nested_;
+		unsigned int previousAllocationPhase_;
+		PerfSample perfStart_;
+		PhaseTimer* outer_;
+		
+		PhaseTimer(const PhaseTimer&);
+		PhaseTimer& operator=(const PhaseTimer&);
+		
+	public:
+		PhaseTimer(Phase phase);
+		~PhaseTimer();
+		
+		void switchTo(Phase phase);
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+* strkernels.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "strkernels.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYTHIA_SSE2
+#include <emmintrin.h>
+#endif
+
+// All functions only treat the ASCII letters as letters, just like the
+// character functions of the C locale that were used before.
+
+/**
+* Determines whether a character is a letter, digit, period or underscore.
+**/
+inline bool isIdentifierCharacter(unsigned char c)
+{
+	return static_cast<unsigned char>((c | 0x20) - 'a') < 26 || static_cast<unsigned char>(c - '0') < 10 || c == '.' || c == '_';
+}
+
+/**
+* Converts an upper case letter to lower case.
+**/
+inline unsigned char foldCharacter(unsigned char c)
+{
+	return static_cast<unsigned char>(c - 'A') < 26 ? c | 0x20 : c;
+}
+
+#ifdef PYTHIA_SSE2
+/**
+* Returns a mask of the bytes that lie in the range [first, first + count).
+* The bytes are shifted so that the range starts at -128 which allows
+* a single signed comparison.
+**/
+inline __m128i rangeMask(__m128i v, unsigned char first, unsigned char count)
+{
+	__m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - first)));
+	return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + count)));
+}
+
+/**
+* Returns a mask of the bytes that are letters.
+**/
+inline __m128i letterMask(__m128i v)
+{
+	return rangeMask(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+}
+
+/**
+* Converts the upper case letters of 16 bytes to lower case.
+**/
+inline __m128i foldBlock(__m128i v)
+{
+	return _mm_or_si128(v, _mm_and_si128(rangeMask(v, 'A', 26), _mm_set1_epi8(0x20)));
+}
+#endif
+
+/**
+* Determines whether a buffer only contains letters, digits, periods and underscores.
+* @param data The buffer.
+* @param size Size of the buffer.
+* @return True if the buffer contains only valid characters.
+**/
+bool isIdentifier(const char* data, size_t size)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	size_t i = 0;
+	
+#ifdef PYTHIA_SSE2
+	for (;size - i >= 16;i+=16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+		
+		__m128i valid = _mm_or_si128(letterMask(v), rangeMask(v, '0', 10));
+		valid = _mm_or_si128(valid, _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+		valid = _mm_or_si128(valid, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+		
+		if (_mm_movemask_epi8(valid) != 0xFFFF) return false;
+	}
+#endif
+
+	for (;i<size;++i)
+	{
+		if (!isIdentifierCharacter(bytes[i])) return false;
+	}
+	
+	return true;
+}
+
+/**
+* Compares two buffers of the same size without regard to the case of letters.
+* @param s1 The first buffer.
+* @param s2 The second buffer.
+* @param size Size of the buffers.
+* @return Indicates whether or not the buffers were equal.
+**/
+bool equalsIgnoreCase(const char* s1, const char* s2, size_t size)
+{
+	const unsigned char* b1 = reinterpret_cast<const unsigned char*>(s1);
+	const unsigned char* b2 = reinterpret_cast<const unsigned char*>(s2);
+	size_t i = 0;
+	
+#ifdef PYTHIA_SSE2
+	for (;size - i >= 16;i+=16)
+	{
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b1 + i));
+		__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b2 + i));
+		
+		// Bytes are equal if they are identical or if they are the same
+		// letter and only differ in the case bit.
+		__m128i difference = _mm_xor_si128(v1, v2);
+		__m128i same = _mm_cmpeq_epi8(difference, _mm_setzero_si128());
+		__m128i caseOnly = _mm_and_si128(_mm_cmpeq_epi8(difference, _mm_set1_epi8(0x20)), letterMask(v1));
+		
+		if (_mm_movemask_epi8(_mm_or_si128(same, caseOnly)) != 0xFFFF) return false;
+	}
+#endif
+
+	for (;i<size;++i)
+	{
+		if (foldCharacter(b1[i]) != foldCharacter(b2[i])) return false;
+	}
+	
+	return true;
+}
+
+/**
+* Mixes 16 bytes into the hash state.
+**/
+inline unsigned long long hashBlock(unsigned long long h, const unsigned char* block)
+{
+	const unsigned long long multiplier = 0x9E3779B97F4A7C15ULL;
+	
+	unsigned long long words[2];
+	memcpy(words, block, 16);
+	
+	h = (h ^ words[0]) * multiplier;
+	h ^= h >> 29;
+	h = (h ^ words[1]) * multiplier;
+	h ^= h >> 32;
+	
+	return h;
+}
+
+/**
+* Calculates a 64-bit hash of a buffer in which upper and lower case letters
+* are the same. The hash is not cryptographically secure.
+* @param data The buffer.
+* @param size Size of the buffer.
+* @return The hash of the buffer.
+**/
+unsigned long long hashIgnoreCase(const char* data, size_t size)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	unsigned long long h = static_cast<unsigned long long>(size) * 0xC2B2AE3D27D4EB4FULL;
+	unsigned char block[16];
+	size_t i = 0;
+	
+#ifdef PYTHIA_SSE2
+	for (;size - i >= 16;i+=16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(block), foldBlock(v));
+		h = hashBlock(h, block);
+	}
+#else
+	for (;size - i >= 16;i+=16)
+	{
+		for (unsigned int j=0;j<16;++j) block[j] = foldCharacter(bytes[i + j]);
+		h = hashBlock(h, block);
+	}
+#endif
+
+	if (i < size)
+	{
+		memset(block, 0, sizeof(block));
+		
+		for (unsigned int j=0;i + j<size;++j) block[j] = foldCharacter(bytes[i + j]);
+		
+		h = hashBlock(h, block);
+	}
+	
+	// Final mixing step of MurmurHash3.
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	
+	return h;
+}
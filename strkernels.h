@@ -0,0 +1,54 @@
+/*
+* strkernels.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef STRKERNELS_H
+#define STRKERNELS_H
+
+#include <cstddef>
+#include <string>
+
+bool isIdentifier(const char* data, size_t size);
+bool equalsIgnoreCase(const char* s1, const char* s2, size_t size);
+unsigned long long hashIgnoreCase(const char* data, size_t size);
+
+/**
+* Determines whether a string only contains letters, digits, periods and
+* underscores (the characters of Delphi identifiers and unit-qualified names).
+* @param str The string to check.
+* @return True if the string contains only valid characters.
+**/
+inline bool isIdentifier(const std::string& str)
+{
+	return isIdentifier(str.data(), str.size());
+}
+
+/**
+* Compares two strings without regard to the case of ASCII letters.
+* @param s1 The first string.
+* @param s2 The second string.
+* @return Indicates whether or not the strings were equal.
+**/
+inline bool equalsIgnoreCase(const std::string& s1, const std::string& s2)
+{
+	return s1.size() == s2.size() && equalsIgnoreCase(s1.data(), s2.data(), s1.size());
+}
+
+/**
+* Calculates a hash of a string that is the same for all strings that
+* equalsIgnoreCase considers equal.
+* @param str The string.
+* @return The hash of the string.
+**/
+inline unsigned long long hashIgnoreCase(const std::string& str)
+{
+	return hashIgnoreCase(str.data(), str.size());
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+* symcache.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "symcache.h"
+#include "stats.h"
+
+SymbolCache::~SymbolCache()
+{
+	for (std::map<std::string, std::string*>::iterator Iter = typeNames_.begin(); Iter != typeNames_.end(); ++Iter)
+	{
+		delete Iter->second;
+	}
+}
+
+/**
+* Returns the shared string object for the name of a type.
+* @param name Name of the type.
+* @return The string object. It must not be modified or deleted.
+**/
+std::string* SymbolCache::typeName(const std::string& name)
+{
+	ScopedLock lock(mutex_);
+	
+	std::string*& str = typeNames_[name];
+	
+	if (!str)
+	{
+		str = new std::string(name);
+		addCounter(COUNTER_SYMBOL_CACHE_MISSES);
+	}
+	else
+	{
+		addCounter(COUNTER_SYMBOL_CACHE_HITS);
+	}
+	
+	return str;
+}
+
+/**
+* Determines whether a string object belongs to the cache.
+* @param str The string object.
+* @return True if the string is owned by the cache.
+**/
+bool SymbolCache::owns(const std::string* str) const
+{
+	ScopedLock lock(mutex_);
+	
+	std::map<std::string, std::string*>::const_iterator Iter = typeNames_.find(*str);
+	
+	return Iter != typeNames_.end() && Iter->second == str;
+}
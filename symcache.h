@@ -0,0 +1,43 @@
+/*
+* symcache.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef SYMCACHE_H
+#define SYMCACHE_H
+
+#include "threads.h"
+
+#include <map>
+#include <string>
+
+/**
+* Symbols that are identical in all files of a batch run and can therefore
+* be shared between the jobs. Only strings that are never obfuscated may
+* be stored here (e.g. the names of property types like TColor or Boolean
+* that are not classes). Class and member names can't be shared because
+* they are renamed in place.
+**/
+class SymbolCache
+{
+	private:
+		mutable Mutex mutex_;
+		std::map<std::string, std::string*> typeNames_;
+		
+		SymbolCache(const SymbolCache&);
+		SymbolCache& operator=(const SymbolCache&);
+		
+	public:
+		SymbolCache() {}
+		~SymbolCache();
+		
+		std::string* typeName(const std::string& name);
+		bool owns(const std::string* str) const;
+};
+
+#endif
@@ -9,6 +9,9 @@
 */
 
 #include "sync.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
 
 #include <algorithm>
 #include <cassert>
@@ -20,14 +23,31 @@
 **/
 void synchronize(DFMData& dfmres, const VMTDir& vmtdir)
 {
+	PhaseTimer timer(PHASE_SYNC);
+	
 	std::vector<std::string*> objectnames;
 
 	std::deque<DFMResource*> dfms;
 	fill(dfmres, dfms);
+	
+	PYTHIA_PROBE1(sync__start, dfms.size());
 
-	std::for_each(dfms.begin(), dfms.end(), SynchronizeName(vmtdir));
-	std::for_each(dfms.begin(), dfms.end(), SynchronizeClassName(vmtdir));
-	std::for_each(dfms.begin(), dfms.end(), SynchronizeProperties(vmtdir, dfmres));
+	{
+		TraceSpan span("sync names");
+		std::for_each(dfms.begin(), dfms.end(), SynchronizeName(vmtdir));
+	}
+	
+	{
+		TraceSpan span("sync class names");
+		std::for_each(dfms.begin(), dfms.end(), SynchronizeClassName(vmtdir));
+	}
+	
+	{
+		TraceSpan span("sync properties");
+		std::for_each(dfms.begin(), dfms.end(), SynchronizeProperties(vmtdir, dfmres));
+	}
+	
+	PYTHIA_PROBE1(sync__done, dfms.size());
 }
 
 /**
@@ -53,6 +53,7 @@ class SynchronizeName
                     
                     if (vmt)
                     {
+                       ensureExtraInfo(vmt);
                        str = getVMTAttribute(vmt->fields, *dfm->name);
                        
                        if (str)
@@ -0,0 +1,141 @@
+/*
+* threads.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "threads.h"
+#include "perfcounters.h"
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+Mutex::Mutex() { InitializeCriticalSection(&section_); }
+Mutex::~Mutex() { DeleteCriticalSection(&section_); }
+void Mutex::lock() { EnterCriticalSection(&section_); }
+void Mutex::unlock() { LeaveCriticalSection(&section_); }
+
+#else
+
+Mutex::Mutex() { pthread_mutex_init(&mutex_, 0); }
+Mutex::~Mutex() { pthread_mutex_destroy(&mutex_); }
+void Mutex::lock() { pthread_mutex_lock(&mutex_); }
+void Mutex::unlock() { pthread_mutex_unlock(&mutex_); }
+
+#endif
+
+/**
+* Atomically adds a value to a counter.
+* @param value The counter.
+* @param delta The value to add.
+* @return The value of the counter before the addition.
+**/
+unsigned int atomicAdd(volatile unsigned int& value, unsigned int delta)
+{
+#ifdef _WIN32
+	return static_cast<unsigned int>(InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(&value), static_cast<LONG>(delta)));
+#else
+	return __sync_fetch_and_add(&value, delta);
+#endif
+}
+
+/**
+* Returns the number of processors that are available to the program.
+**/
+unsigned int hardwareThreads()
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	unsigned int count = static_cast<unsigned int>(si.dwNumberOfProcessors);
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return count > 0 ? static_cast<unsigned int>(count) : 1;
+}
+
+/**
+* Parameters of a single thread started by runThreads.
+**/
+struct ThreadStart
+{
+	ThreadFunction function;
+	void* argument;
+};
+
+#ifdef _WIN32
+unsigned int __stdcall threadMain(void* start)
+#else
+void* threadMain(void* start)
+#endif
+{
+	ThreadStart* ts = static_cast<ThreadStart*>(start);
+	ts->function(ts->argument);
+	
+	// The counters are opened per thread and would stay open otherwise.
+	releasePerfCounters();
+	
+	return 0;
+}
+
+/**
+* Runs a function on a number of threads and waits until all threads
+* have finished. The calling thread is used as one of the threads.
+* @param count Number of threads.
+* @param function The function to run.
+* @param argument Argument that's passed to each call of the function.
+**/
+void runThreads(unsigned int count, ThreadFunction function, void* argument)
+{
+	ThreadStart ts;
+	ts.function = function;
+	ts.argument = argument;
+
+#ifdef _WIN32
+	std::vector<HANDLE> threads;
+	
+	for (unsigned int i=1;i<count;++i)
+	{
+		HANDLE thread = reinterpret_cast<HANDLE>(_beginthreadex(0, 0, threadMain, &ts, 0, 0));
+		if (!thread) break;
+		threads.push_back(thread);
+	}
+	
+	function(argument);
+	
+	for (unsigned int i=0;i<threads.size();++i)
+	{
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+#else
+	std::vector<pthread_t> threads;
+	
+	for (unsigned int i=1;i<count;++i)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, 0, threadMain, &ts)) break;
+		threads.push_back(thread);
+	}
+	
+	function(argument);
+	
+	for (unsigned int i=0;i<threads.size();++i)
+	{
+		pthread_join(threads[i], 0);
+	}
+#endif
+}
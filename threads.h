@@ -0,0 +1,72 @@
+/*
+* threads.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+* A simple non-recursive mutex.
+**/
+class Mutex
+{
+	private:
+#ifdef _WIN32
+		CRITICAL_SECTION section_;
+#else
+		pthread_mutex_t mutex_;
+#endif
+
+		Mutex(const Mutex&);
+		Mutex& operator=(const Mutex&);
+		
+	public:
+		Mutex();
+		~Mutex();
+		
+		void lock();
+		void unlock();
+};
+
+/**
+* Locks a mutex for the lifetime of the object.
+**/
+class ScopedLock
+{
+	private:
+		Mutex& mutex_;
+		
+		ScopedLock(const ScopedLock&);
+		ScopedLock& operator=(const ScopedLock&);
+		
+	public:
+		ScopedLock(Mutex& mutex) : mutex_(mutex) { mutex_.lock(); }
+		~ScopedLock() { mutex_.unlock(); }
+};
+
+/// Declares a variable that every thread has its own copy of (only for POD types).
+#ifdef _MSC_VER
+#define PYTHIA_THREAD_LOCAL __declspec(thread)
+#else
+#define PYTHIA_THREAD_LOCAL __thread
+#endif
+
+typedef void (*ThreadFunction)(void*);
+
+unsigned int atomicAdd(volatile unsigned int& value, unsigned int delta);
+unsigned int hardwareThreads();
+void runThreads(unsigned int count, ThreadFunction function, void* argument);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+* trace.cpp - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#include "trace.h"
+#include "stats.h"
+#include "threads.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+/**
+* A finished span of the trace.
+**/
+struct TraceEvent
+{
+	const char* name;
+	std::string detail;
+	unsigned long long start;
+	unsigned long long end;
+};
+
+/**
+* The events that were recorded by one thread. Only the owning thread
+* writes to the buffer, so recording an event needs no lock.
+**/
+struct TraceBuffer
+{
+	unsigned int thread;
+	std::vector<TraceEvent> events;
+	TraceBuffer* next;
+};
+
+volatile bool g_tracing = false;
+
+PYTHIA_THREAD_LOCAL TraceBuffer* t_trace;
+
+/// All buffers that were ever created. Buffers of finished threads are kept.
+TraceBuffer* g_traceBuffers;
+unsigned int g_traceThreads;
+unsigned long long g_traceStart;
+Mutex g_traceMutex;
+
+/**
+* Enables tracing. Events are recorded relative to the time of this call.
+**/
+void startTracing()
+{
+	g_traceStart = monotonicTime();
+	g_tracing = true;
+}
+
+/**
+* Returns the trace buffer of the calling thread.
+**/
+TraceBuffer& threadTrace()
+{
+	if (!t_trace)
+	{
+		TraceBuffer* buffer = new TraceBuffer();
+		
+		ScopedLock lock(g_traceMutex);
+		buffer->thread = ++g_traceThreads;
+		buffer->next = g_traceBuffers;
+		g_traceBuffers = buffer;
+		t_trace = buffer;
+	}
+	
+	return *t_trace;
+}
+
+/**
+* Records a span of the trace.
+* @param name Name of the span. Must be a string literal.
+* @param detail Optional information about the span (a file name, ...).
+* @param start Begin of the span (see monotonicTime).
+* @param end End of the span.
+**/
+void addTraceEvent(const char* name, const std::string& detail, unsigned long long start, unsigned long long end)
+{
+	if (!g_tracing) return;
+	
+	TraceEvent event;
+	event.name = name;
+	event.detail = detail;
+	event.start = start;
+	event.end = end;
+	
+	threadTrace().events.push_back(event);
+}
+
+TraceSpan::TraceSpan(const char* name) : name_(name), start_(g_tracing ? monotonicTime() : 0)
+{
+}
+
+TraceSpan::TraceSpan(const char* name, const std::string& detail) : name_(name), start_(g_tracing ? monotonicTime() : 0)
+{
+	if (g_tracing) detail_ = detail;
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (g_tracing) addTraceEvent(name_, detail_, start_, monotonicTime());
+}
+
+/**
+* Escapes a string for use in a JSON document.
+**/
+std::string escapeJson(const std::string& str)
+{
+	std::string ret;
+	
+	for (unsigned int i=0;i<str.size();++i)
+	{
+		unsigned char c = str[i];
+		
+		if (c == '"' || c == '\\')
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if (c < 0x20)
+		{
+			char buffer[8];
+			sprintf(buffer, "\\u%04x", c);
+			ret += buffer;
+		}
+		else
+		{
+			ret += c;
+		}
+	}
+	
+	return ret;
+}
+
+/**
+* Formats a time of the trace in microseconds.
+**/
+std::string traceTime(unsigned long long nanoseconds)
+{
+	char buffer[32];
+	sprintf(buffer, "%llu.%03llu", nanoseconds / 1000, nanoseconds % 1000);
+	return buffer;
+}
+
+/**
+* Writes all recorded spans in the Chrome trace event format that can be
+* loaded into chrome://tracing or Perfetto. Must not be called while other
+* threads are still recording.
+* @param filename Name of the trace file.
+* @return True if the file was written.
+**/
+bool writeTrace(const std::string& filename)
+{
+	std::ofstream file(filename.c_str());
+	
+	if (!file) return false;
+	
+	ScopedLock lock(g_traceMutex);
+	
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"pythia\"}}";
+	
+	for (TraceBuffer* buffer = g_traceBuffers; buffer; buffer = buffer->next)
+	{
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+			<< ",\"args\":{\"name\":\"thread " << buffer->thread << "\"}}";
+		
+		for (unsigned int i=0;i<buffer->events.size();++i)
+		{
+			const TraceEvent& event = buffer->events[i];
+			
+			file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"pythia\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+				<< ",\"ts\":" << traceTime(event.start - g_traceStart) << ",\"dur\":" << traceTime(event.end - event.start);
+			
+			if (!event.detail.empty())
+			{
+				file << ",\"args\":{\"detail\":\"" << escapeJson(event.detail) << "\"}";
+			}
+			
+			file << "}";
+		}
+	}
+	
+	file << "\n]}\n";
+	
+	return file.good();
+}
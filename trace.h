@@ -0,0 +1,43 @@
+/*
+* trace.h - Proof of concept for a Delphi Obfuscator
+*
+* Copyright (c) 2005 Sebastian Porst (webmaster@the-interweb.com)
+* All rights reserved.
+*
+* This software is licensed under the zlib/libpng License.
+* For more details see http://www.opensource.org/licenses/zlib-license.php
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+extern volatile bool g_tracing;
+
+void startTracing();
+void addTraceEvent(const char* name, const std::string& detail, unsigned long long start, unsigned long long end);
+bool writeTrace(const std::string& filename);
+std::string escapeJson(const std::string& str);
+
+/**
+* Records the time from its construction to its destruction as a span
+* of the trace. Does nothing if tracing is disabled.
+**/
+class TraceSpan
+{
+	private:
+		const char* name_;
+		std::string detail_;
+		unsigned long long start_;
+		
+		TraceSpan(const TraceSpan&);
+		TraceSpan& operator=(const TraceSpan&);
+		
+	public:
+		TraceSpan(const char* name);
+		TraceSpan(const char* name, const std::string& detail);
+		~TraceSpan();
+};
+
+#endif
@@ -9,114 +9,238 @@
 */
 
 #include "write.h"
+#include "patchfile.h"
+#include "stats.h"
 
 #include <algorithm>
 
 /**
-* Used write the name elements of objects to a file.
+* Used to add the name elements of objects to a patch list.
 **/
 template<typename T>
 class WriteName
 {
-	std::fstream& file_;
+	PatchList& patches_;
 	
 	public:
-		WriteName(std::fstream& file) : file_(file) {}
+		WriteName(PatchList& patches) : patches_(patches) {}
 		
-		void operator()(T& x)
+		void operator()(const T& x)
 		{
-			file_.seekp(x.nameoffset + 1);
-			file_.write(x.name->c_str(), static_cast<unsigned int>(x.name->length()));
-			if (!file_) throw new std::string("Error: Couldn't write file.");
+			patches_.add(x.nameoffset + 1, *x.name);
 		}
 };
 
 /**
-* Stores the obfuscated data back to the file.
-* @param filename Name of the file where data is written to.
+* Joins the segments of a name with period characters.
+* @param name The segments of the name.
+* @return The complete name.
+**/
+std::string joinName(const std::vector<std::string*>& name)
+{
+	std::string ret;
+	
+	for (unsigned int i=0;i<name.size();++i)
+	{
+		if (i) ret += ".";
+		ret += *name[i];
+	}
+	
+	return ret;
+}
+
+/**
+* Counts the patches and bytes that collectPatches adds for a property and
+* the properties of its collection items.
+**/
+void countPatches(const DFMProperty& property, size_t& patches, size_t& bytes)
+{
+	if (property.name.size())
+	{
+		++patches;
+		bytes += propertyNameLength(property.name);
+	}
+	
+	if (property.value.size() && property.obfuscateValue)
+	{
+		++patches;
+		bytes += propertyNameLength(property.value);
+	}
+	
+	for (unsigned int i=0;i<property.values.size();++i)
+	{
+		countPatches(property.values[i], patches, bytes);
+	}
+}
+
+/**
+* Counts the patches and bytes that collectPatches adds for the names of
+* class members.
+**/
+template<typename T>
+void countPatches(const std::vector<T>& members, unsigned int first, unsigned int count, size_t& patches, size_t& bytes)
+{
+	patches += count;
+	
+	for (unsigned int i=first;i<first + count;++i)
+	{
+		bytes += members[i].name->length();
+	}
+}
+
+/**
+* Collects all changes that are necessary to store the obfuscated data.
 * @param dfmresources Obfuscated DFM data
-* @param vmtdir Obfuscated VMT data.
+* @param classes Obfuscated VMT data.
+* @param pef The file the data belongs to.
+* @param patches The changes are added to this list.
 **/
-void store(const std::string& filename, const DFMData& dfmresources, VMTDir& vmtdir, PeLib::PeFile32& pef)
+void collectPatches(const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef, PatchList& patches)
 {
-    std::fstream file(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
-    
     PeLib::PeHeader32& peh = pef.peHeader();
     
-	if (!file) throw new std::string("Error: Couldn't open file.");
+	std::deque<DFMResource*> dfms;
+	fill(dfmresources, dfms);
 	
-	std::deque<VMT*> vmts;
-	fill(vmtdir, vmts);
-
-	for (std::deque<VMT*>::iterator Iter = vmts.begin(); Iter != vmts.end(); ++Iter)
+	// The patch list is sized in advance because it's the largest structure
+	// of the store phase and growing it would copy it several times.
+	size_t patchCount = 0;
+	size_t byteCount = 0;
+	
+	for (std::vector<ClassRecord>::const_iterator Iter = classes.records.begin(); Iter != classes.records.end(); ++Iter)
+	{
+		unsigned int copies = Iter->vmtTypeInfo ? 2 : 1;
+		patchCount += copies;
+		byteCount += copies * Iter->name->length();
+		
+		countPatches(classes.properties, Iter->firstProperty, Iter->propertyCount, patchCount, byteCount);
+		countPatches(classes.fields, Iter->firstField, Iter->fieldCount, patchCount, byteCount);
+		countPatches(classes.methods, Iter->firstMethod, Iter->methodCount, patchCount, byteCount);
+	}
+	
+	for (std::deque<DFMResource*>::const_iterator Iter = dfms.begin(); Iter != dfms.end(); ++Iter)
 	{
-		file.seekp((*Iter)->nameoffset + 1);
-		file.write((*Iter)->name->c_str(), static_cast<unsigned int>((*Iter)->name->length()));
-		if (!file) throw new std::string("Error: Couldn't write file.");
+		patchCount += 2;
+		byteCount += (*Iter)->classname->length() + (*Iter)->name->length();
 		
-		if ((*Iter)->vmtTypeInfo)
+		for (unsigned int i=0;i<(*Iter)->properties.size();++i)
 		{
-			file.seekp(peh.vaToOffset((*Iter)->vmtTypeInfo) + 2);
-			file.write((*Iter)->name->c_str(), static_cast<unsigned int>((*Iter)->name->length()));
-			if (!file) throw new std::string("Error: Couldn't write file.");
+			countPatches((*Iter)->properties[i], patchCount, byteCount);
 		}
-		
-		std::for_each((*Iter)->typeinfo.begin(), (*Iter)->typeinfo.end(), WriteName<PropInfo>(file));
-		std::for_each((*Iter)->fields.begin(), (*Iter)->fields.end(), WriteName<FieldInfo>(file));
-		std::for_each((*Iter)->methods.begin(), (*Iter)->methods.end(), WriteName<MethodInfo>(file));
 	}
 	
-	std::deque<DFMResource*> dfms;
-	fill(dfmresources, dfms);
+	patches.reserve(patchCount, byteCount);
+	
+	for (std::vector<ClassRecord>::const_iterator Iter = classes.records.begin(); Iter != classes.records.end(); ++Iter)
+	{
+		patches.add(Iter->nameoffset + 1, *Iter->name);
+		
+		if (Iter->vmtTypeInfo)
+		{
+			patches.add(peh.vaToOffset(Iter->vmtTypeInfo) + 2, *Iter->name);
+		}
+		
+		// Patches are added class by class (roughly in file order) so
+		// that coalescing them has little to sort.
+		std::vector<PropInfo>::const_iterator properties = classes.properties.begin() + Iter->firstProperty;
+		std::vector<FieldInfo>::const_iterator fields = classes.fields.begin() + Iter->firstField;
+		std::vector<MethodInfo>::const_iterator methods = classes.methods.begin() + Iter->firstMethod;
+		
+		std::for_each(properties, properties + Iter->propertyCount, WriteName<PropInfo>(patches));
+		std::for_each(fields, fields + Iter->fieldCount, WriteName<FieldInfo>(patches));
+		std::for_each(methods, methods + Iter->methodCount, WriteName<MethodInfo>(patches));
+	}
 	
 	for (std::deque<DFMResource*>::iterator Iter = dfms.begin(); Iter != dfms.end(); ++Iter)
 	{
 		DFMResource* dfm = *Iter;
 
-		file.seekp(dfm->offset + 1);
-		file.write(dfm->classname->c_str(), static_cast<unsigned int>(dfm->classname->length()));
-		file.seekp(1, std::ios_base::cur);
-		file.write(dfm->name->c_str(), static_cast<unsigned int>(dfm->name->length()));
+		patches.add(dfm->offset + 1, *dfm->classname);
+		patches.add(dfm->offset + 2 + static_cast<unsigned int>(dfm->classname->length()), *dfm->name);
 		
-		std::deque<DFMProperty> dfmps(dfm->properties.begin(), dfm->properties.end());
+		std::deque<const DFMProperty*> dfmps;
+		
+		for (unsigned int i=0;i<dfm->properties.size();++i)
+		{
+			dfmps.push_back(&dfm->properties[i]);
+		}
 		
 		while (dfmps.size())
 		{
-			DFMProperty property = dfmps[0];
+			const DFMProperty& property = *dfmps[0];
 			dfmps.pop_front();
 			
-			file.seekp(property.offset + 1);
-			
 			if (property.name.size())
 			{
-				for (unsigned int j=0;j<property.name.size() - 1;++j)
-				{
-					file.write(property.name[j]->c_str(), static_cast<unsigned int>(property.name[j]->length()));
-					file.write(".", 1);
-				}
-
-				file.write(property.name.back()->c_str(), static_cast<unsigned int>(property.name.back()->length()));
+				patches.add(property.offset + 1, joinName(property.name));
 			}
 			
-			if (property.value.size())
+			if (property.value.size() && property.obfuscateValue)
 			{
-				file.seekp(property.offset + propertyNameLength(property.name) + 3);
+				unsigned int offset = property.offset + propertyNameLength(property.name) + 3;
 				
 				if (property.type == DFM_BITMAP)
 				{
-					file.seekp(4, std::ios_base::cur);
+					offset += 4;
 				}
-					
-				for (unsigned int i=0;i<property.value.size() - 1;i++)
-				{
-					file.write(property.value[i]->c_str(), static_cast<unsigned int>(property.value[i]->length()));
-					file.write(".", 1);
-				}
-
-				file.write(property.value.back()->c_str(), static_cast<unsigned int>(property.value.back()->length()));
+				
+				patches.add(offset, joinName(property.value));
 			}
 			
-			std::copy(property.values.begin(), property.values.end(), std::back_inserter(dfmps));
+			for (unsigned int i=0;i<property.values.size();++i)
+			{
+				dfmps.push_back(&property.values[i]);
+			}
 		}
 	}
 }
+
+/**
+* Stores the obfuscated data back to the file. All changes are collected
+* first and then written in a single pass over the file.
+* @param filename Name of the file the data was read from.
+* @param output Name of the file where data is written to. If empty the
+*        file is modified in place. Otherwise the changes are written to a
+*        copy of the file which then atomically replaces the output file
+*        (the output file may be the input file).
+* @param dfmresources Obfuscated DFM data
+* @param classes Obfuscated VMT data.
+* @param pef The file the data belongs to.
+* @return The number of patches and the number of bytes that were changed.
+**/
+PatchSummary store(const std::string& filename, const std::string& output, const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef)
+{
+	PhaseTimer timer(PHASE_STORE);
+	
+	PatchList patches;
+	
+	collectPatches(dfmresources, classes, pef, patches);
+	
+	patches.coalesce();
+	
+	return writePatches(filename, output, patches);
+}
+
+/**
+* Stores the changes that are necessary to obfuscate a file in a patch file
+* instead of changing the file.
+* @param patchfile Name of the patch file.
+* @param filename Name of the file the data was read from.
+* @param dfmresources Obfuscated DFM data
+* @param classes Obfuscated VMT data.
+* @param pef The file the data belongs to.
+* @param mapping The names that were assigned during obfuscation.
+* @return The number of patches and the number of bytes that will be changed.
+**/
+PatchSummary exportPatches(const std::string& patchfile, const std::string& filename, const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef, const NameMapping& mapping)
+{
+	PhaseTimer timer(PHASE_STORE);
+	
+	PatchList patches;
+	
+	collectPatches(dfmresources, classes, pef, patches);
+	
+	patches.coalesce();
+	
+	return savePatchFile(patchfile, filename, patches, mapping);
+}
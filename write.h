@@ -12,10 +12,15 @@
 #define WRITE_H
 
 #include "DFMParser.h"
-#include "VMTDir.h"
+#include "classstore.h"
+#include "patch.h"
+#include "mapping.h"
 
 #include <string>
 
-void store(const std::string& filename, const DFMData& dfmresources, VMTDir& vmtdir, PeLib::PeFile32& pef);
+std::string joinName(const std::vector<std::string*>& name);
+void collectPatches(const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef, PatchList& patches);
+PatchSummary store(const std::string& filename, const std::string& output, const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef);
+PatchSummary exportPatches(const std::string& patchfile, const std::string& filename, const DFMData& dfmresources, const ClassStore& classes, PeLib::PeFile32& pef, const NameMapping& mapping);
 
 #endif